@@ -0,0 +1,336 @@
+#ifndef SINGLETON_CHECKER_ANALYSIS_DATA_H
+#define SINGLETON_CHECKER_ANALYSIS_DATA_H
+
+#include "AnalysisKinds.h"
+#include "clang/AST/AST.h"
+#include "clang/Basic/SourceManager.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace clang;
+
+namespace SingletonChecker {
+
+// Call of a getInstance function executed on every iteration of the
+// enclosing loops: the instance could be fetched once before them.
+struct HotCallSite {
+    const CallExpr* call             = nullptr;
+    const FunctionDecl* caller       = nullptr;
+    const FunctionDecl* getInstance  = nullptr;
+    unsigned loopDepth               = 0;
+
+    // Whether part of the loop statement runs on every iteration: all of it
+    // but the init of a for and the range of a range-based for.
+    static bool runsPerIteration(const Stmt* loop, const Stmt* part)
+    {
+        if (auto* forStmt = dyn_cast<ForStmt>(loop))
+            return part != forStmt->getInit();
+        if (auto* rangeFor = dyn_cast<CXXForRangeStmt>(loop))
+            return part == rangeFor->getBody() || part == rangeFor->getLoopVarStmt();
+        return isa<WhileStmt>(loop) || isa<DoStmt>(loop);
+    }
+};
+
+// Static instance of a singleton that runs code before main.
+struct StartupInit {
+    const VarDecl* instance                 = nullptr;
+    const CXXRecordDecl* singleton          = nullptr;
+    const CXXConstructorDecl* constructor   = nullptr;  // none for e.g. a call
+    bool dynamicInit                        = false;    // not constant initialized
+    bool registersDestructor                = false;    // destructor registered with atexit
+};
+
+struct AnalysisData : AnalysisKinds {
+    bool ctorsPrivate                   : 1; 
+    bool hasMethodLikelyInstance        : 1; 
+    bool hasFriendFunctionLikelyInstance: 1; 
+    bool hasDeletedCopyConstuctor       : 1; 
+    bool hasDeletedAssigmentOperator    : 1;
+    bool isSingltone                   : 1;
+    bool hiddenInstanceMethod           : 1;
+    bool probabalyNaiveSingletone       : 1;
+    bool probabalyCRTPSingletone        : 1;
+    bool unknownPatternSingletone       : 1;
+    bool probablyMayersSingletone       : 1;
+    bool probablyFlagsNaiveSingletone   : 1;
+    bool probablyIfNaiveSingletone      : 1;
+    bool skippedByBudget                : 1;    // a body exceeded the node budget
+    bool smartPointerInstance           : 1;    // instance held by std::unique_ptr/shared_ptr
+    unsigned int amountObjects          : 27;
+    
+    ConditionPatternInGetInstance conditionPatternInGetInstance;
+    AccessCost accessCost;
+
+    SourceManager* SM = nullptr;
+    CXXMethodDecl* methodLikeGetInstance         = nullptr;      
+    FunctionDecl* friendFunctionLikeGetInstance  = nullptr;      
+    VarDecl* instanceField                       = nullptr;
+    BinaryOperator* assignmentInIfSinglton       = nullptr;
+    // Base<Class> specialization providing getInstance to a CRTP derived class.
+    const ClassTemplateSpecializationDecl* crtpBase = nullptr;
+    std::string className;
+    SourceLocation location;
+    
+    inline void  clear() noexcept
+    {
+        probabalyCRTPSingletone = false;
+        probablyIfNaiveSingletone = false;
+        probablyMayersSingletone = false;
+        probablyFlagsNaiveSingletone = false;
+        skippedByBudget = false;
+        smartPointerInstance = false;
+        accessCost = UnknownCost;
+        methodLikeGetInstance = nullptr;      
+        friendFunctionLikeGetInstance = nullptr;
+        instanceField = nullptr;
+        hiddenInstanceMethod = false;
+        ctorsPrivate = true;
+        hasMethodLikelyInstance = false;
+        hasDeletedCopyConstuctor = false;
+        hasDeletedAssigmentOperator = false;
+        isSingltone = true;
+        amountObjects = 0;
+        probabalyNaiveSingletone = false;
+        hasFriendFunctionLikelyInstance = false;
+        unknownPatternSingletone = false;
+        assignmentInIfSinglton = nullptr;
+        crtpBase = nullptr;
+        conditionPatternInGetInstance = UnknownCondition;
+        SM = nullptr;
+        className.clear();
+        location = SourceLocation();
+
+    }
+
+    // Folds the findings of a getInstance candidate analysed on its own 
+    // (see ScanCache) into the data of the class being analysed.
+    inline void mergeGetInstanceFindings(const AnalysisData& other) noexcept
+    {
+        probabalyNaiveSingletone |= other.probabalyNaiveSingletone;
+        probablyMayersSingletone |= other.probablyMayersSingletone;
+        probablyIfNaiveSingletone |= other.probablyIfNaiveSingletone;
+        probablyFlagsNaiveSingletone |= other.probablyFlagsNaiveSingletone;
+        unknownPatternSingletone |= other.unknownPatternSingletone;
+        skippedByBudget |= other.skippedByBudget;
+        smartPointerInstance |= other.smartPointerInstance;
+        accessCost = std::max(accessCost, other.accessCost);
+        if (other.instanceField)
+            instanceField = other.instanceField;
+        if (other.assignmentInIfSinglton)
+            assignmentInIfSinglton = other.assignmentInIfSinglton;
+        if (other.conditionPatternInGetInstance != UnknownCondition)
+            conditionPatternInGetInstance = other.conditionPatternInGetInstance;
+    }
+
+    // Base<Class> with its template arguments, e.g. "Singleton<Logger>".
+    std::string crtpBaseName() const
+    {
+        std::string name;
+        if (crtpBase) {
+            llvm::raw_string_ostream os(name);
+            crtpBase->getNameForDiagnostic(os, crtpBase->getASTContext().getPrintingPolicy(),
+                                           /*Qualified=*/true);
+        }
+        return name;
+    }
+
+    inline void dump(llvm::raw_ostream& os = llvm::outs()) const noexcept
+    {
+        const int totalWidth = 90;
+        const int labelWidth = 60;
+        
+        auto printLine = [&](const std::string& text) {
+            os << "║ " << text << "\n";
+        };
+        
+        auto printField = [&](const std::string& label, const std::string& value, bool highlight = false) {
+            std::string line = "│   • " + label + ":";
+            line.resize(labelWidth, ' ');
+            line += value;
+            if (highlight) {
+                line += " ⚡";
+            }
+            printLine(line);
+        };
+        
+        auto printSection = [&](const std::string& title) {
+            std::string line = "│ " + title;
+            printLine(line);
+        };
+        
+        auto printSubSection = [&](const std::string& title) {
+            std::string line = "│   ─ " + title;
+            printLine(line);
+        };
+        
+        auto getAccessString = [](AccessSpecifier access) -> std::string {
+            switch (access) {
+                case AS_public: return "public";
+                case AS_private: return "private";
+                case AS_protected: return "protected";
+                case AS_none: return "none";
+                default: return "unknown";
+            }
+        };
+
+        auto getConditionPatternString = [](ConditionPatternInGetInstance pattern) -> std::string {
+            switch (pattern) {
+                case UnaryOperatorInCondition: return "Unary Operator (e.g., !instance)";
+                case BinaryOperatorInConditionNullptr: return "Binary Operator (e.g., instance == nullptr)";
+                case BinaryOperatorInConditionNull: return "Binary Operator (e.g., instance == NULL)";
+                case VarInCondition: return "Variable directly in condition";
+                case UnknownCondition: return "Unknown condition pattern";
+                default: return "Not analyzed";
+            }
+        };
+        
+        os << "\n";
+        os << "╔══════════════════════════════════════════════════════════════════════════════════════╗\n";
+        os << "║                           SINGLETON PATTERN ANALYSIS REPORT                          ║\n";
+        os << "╠══════════════════════════════════════════════════════════════════════════════════════╣\n";
+        
+        // Basic Class Information
+        printLine("│ 📋 CLASS INFORMATION");
+        printField("Class Name", className);
+        printField("Location", location.printToString(*SM));
+        
+        os << "╠══════════════════════════════════════════════════════════════════════════════════════╣\n";
+        printLine("│ 🔍 SINGLETON PATTERN ANALYSIS");
+        
+        // Core Singleton Requirements
+        printSection("Core Requirements:");
+        printField("Private Constructors", ctorsPrivate ? " ✓ YES" : " ✗ NO", ctorsPrivate);
+        printField("Deleted Copy Constructor", hasDeletedCopyConstuctor ? " ✓ YES" : " ✗ NO", hasDeletedCopyConstuctor);
+        printField("Deleted Assignment Operator", hasDeletedAssigmentOperator ? " ✓ YES" : " ✗ NO", hasDeletedAssigmentOperator);
+        printField("Static Instances Count", std::to_string(amountObjects), amountObjects == 1);
+        
+        // GetInstance Method Analysis
+        printSection("GetInstance Method Analysis:");
+        printField("GetInstance Method Found", hasMethodLikelyInstance ? " ✓ YES" : " ✗ NO", hasMethodLikelyInstance);
+        
+        if (hasMethodLikelyInstance && methodLikeGetInstance) {
+            printField("  Method Name", methodLikeGetInstance->getNameAsString());
+            printField("  Method Access", getAccessString(methodLikeGetInstance->getAccess()));
+            printField("  Method Location", methodLikeGetInstance->getLocation().printToString(*SM));
+            printField("  Method Hidden", hiddenInstanceMethod ? " ✓ YES" : " ✗ NO");
+            
+            if (methodLikeGetInstance->hasBody()) {
+                printField("  Has Method Body", " ✓ YES");
+            }
+            if (crtpBase) {
+                printField("  Inherited From", crtpBaseName());
+            }
+        }
+        
+        // Friend Function Analysis
+        printSection("Friend Function Analysis:");
+        printField("Friend GetInstance Function", hasFriendFunctionLikelyInstance ? " ✓ YES" : " ✗ NO", 
+                   hasFriendFunctionLikelyInstance);
+        
+        if (hasFriendFunctionLikelyInstance && friendFunctionLikeGetInstance) {
+            printField("  Friend Function Name", friendFunctionLikeGetInstance->getNameAsString());
+            printField("  Friend Function Location", 
+                       friendFunctionLikeGetInstance->getLocation().printToString(*SM));
+        }
+        
+        // Instance Field Analysis
+        printSection("Instance Field Analysis:");
+        if (instanceField) {
+            printField("Instance Field Found", " ✓ YES", true);
+            printField("  Field Name", instanceField->getNameAsString());
+            printField("  Field Type", instanceField->getType().getAsString());
+            printField("  Field Access", getAccessString(instanceField->getAccess()));
+            printField("  Field Location", instanceField->getLocation().printToString(*SM));
+            printField("  Is Static", instanceField->isStaticDataMember() ? " ✓ YES" : " ✗ NO");
+            printField("  Is Static Local", instanceField->isStaticLocal() ? " ✓ YES" : " ✗ NO");
+        } else {
+            printField("Instance Field Found", " ✗ NOT FOUND");
+        }
+        
+        // Pattern Detection
+        printSection("Singleton Pattern Detection:");
+        printField("Probably Naive Singleton", probabalyNaiveSingletone ? " ✓ DETECTED" : " ✗ NOT DETECTED", 
+                   probabalyNaiveSingletone);
+        printField("Probably Mayer's Singleton", probablyMayersSingletone ? " ✓ DETECTED" : " ✗ NOT DETECTED", 
+                   probablyMayersSingletone);
+        printField("Probably CRTP Singleton", probabalyCRTPSingletone ? " ✓ DETECTED" : " ✗ NOT DETECTED", 
+                   probabalyCRTPSingletone);
+        printField("Probably If-Naive Singleton", probablyIfNaiveSingletone ? " ✓ DETECTED" : " ✗ NOT DETECTED", 
+                   probablyIfNaiveSingletone);
+        printField("Probably Flags-Naive Singleton", probablyFlagsNaiveSingletone ? " ✓ DETECTED" : " ✗ NOT DETECTED", 
+                   probablyFlagsNaiveSingletone);
+        printField("Unknown Pattern Singleton", unknownPatternSingletone ? " ⚠ DETECTED" : " ✗ NOT DETECTED");
+        
+        // Condition Pattern Analysis
+        printSection("Condition Pattern in GetInstance:");
+        printField("Condition Pattern", getConditionPatternString(conditionPatternInGetInstance));
+
+        printSection("GetInstance Access Cost:");
+        printField("Cost per Call", accessCostName(accessCost).str(), accessCost == MutexEveryCall);
+        if (smartPointerInstance)
+            printField("  Instance Holder", "smart pointer");
+        
+        // Assignment in If Analysis
+        if (assignmentInIfSinglton) {
+            printSection("Assignment in If Statement:");
+            printField("Assignment Found", " ✓ DETECTED", true);
+            printField("  Assignment Location", assignmentInIfSinglton->getBeginLoc().printToString(*SM));
+            printField("  Operator", "BO_Assign");
+        }
+        
+        // Final Conclusion
+        os << "╠══════════════════════════════════════════════════════════════════════════════════════╣\n";
+        printLine("│ 🎯 FINAL CONCLUSION");
+        
+        std::string conclusion;
+        std::string conclusionIcon;
+        
+        if (skippedByBudget) {
+            conclusion = " SKIPPED (budget): a body exceeds the node budget";
+            conclusionIcon = "⚠";
+        } else if (isSingltone) {
+            conclusion = " ✓ LIKELY SINGLETON PATTERN DETECTED";
+            conclusionIcon = "✅";
+        } else {
+            conclusion = " ✗ NOT A SINGLETON PATTERN";
+            conclusionIcon = "❌";
+        }
+        
+        printLine("│ " + conclusionIcon + conclusion);
+        
+        // Additional pattern details
+        if (isSingltone) {
+            printLine("│");
+            printLine("│ 📝 DETECTED PATTERN DETAILS:");
+            
+            if (probabalyNaiveSingletone) {
+                printLine("│   • Naive Singleton: Static instance field with lazy initialization");
+            }
+            if (probablyMayersSingletone) {
+                printLine("│   • Meyer's Singleton: Static local variable in GetInstance method");
+            }
+            if (probabalyCRTPSingletone) {
+                printLine("│   • CRTP Singleton: Curiously Recurring Template Pattern implementation");
+            }
+            if (probablyIfNaiveSingletone) {
+                printLine("│   • If-Naive Singleton: Conditional initialization in GetInstance");
+            }
+            if (probablyFlagsNaiveSingletone) {
+                printLine("│   • Flags-Naive Singleton: Boolean flag-based initialization control");
+            }
+            if (unknownPatternSingletone) {
+                printLine("│   • Unknown Pattern: Custom singleton implementation detected");
+            }
+        }
+        
+        os << "╚══════════════════════════════════════════════════════════════════════════════════════╝\n";
+        os << "\n";
+    }
+
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_ANALYSIS_DATA_H
@@ -0,0 +1,62 @@
+#ifndef SINGLETON_CHECKER_ANALYSIS_KINDS_H
+#define SINGLETON_CHECKER_ANALYSIS_KINDS_H
+
+#include "llvm/ADT/StringRef.h"
+
+namespace SingletonChecker {
+
+// Enums of AnalysisData that outlive the AST: their values are stored in
+// the detection indexes and their names are read back by singleton-query,
+// which links LLVM Support only.
+struct AnalysisKinds {
+    enum ConditionPatternInGetInstance {
+        UnaryOperatorInCondition,
+        BinaryOperatorInConditionNullptr,
+        BinaryOperatorInConditionNull,
+        VarInCondition,
+        UnknownCondition,
+    };
+
+    // What the fast path of getInstance pays on every call, cheapest first.
+    enum AccessCost {
+        UnknownCost,
+        PlainLoad,              // pointer, relaxed atomic or constant initialized static
+        StaticGuard,            // guard check of a dynamically initialized local static
+        AtomicAcquire,          // atomic load with acquire (or stronger) ordering
+        DoubleCheckedLocking,   // checked load, the mutex only on the slow path
+        CallOnce,               // std::call_once / pthread_once
+        MutexEveryCall,         // mutex locked before the instance is checked
+    };
+
+    // Names of the enum values in the machine-readable reports and in the
+    // queries of the detection indexes, which store the values themselves.
+    static llvm::StringRef conditionName(ConditionPatternInGetInstance pattern)
+    {
+        switch (pattern) {
+            case UnaryOperatorInCondition: return "unary";
+            case BinaryOperatorInConditionNullptr: return "compare-nullptr";
+            case BinaryOperatorInConditionNull: return "compare-null";
+            case VarInCondition: return "var";
+            case UnknownCondition: return "unknown";
+        }
+        return "unknown";
+    }
+
+    static llvm::StringRef accessCostName(AccessCost cost)
+    {
+        switch (cost) {
+            case PlainLoad: return "plain-load";
+            case StaticGuard: return "static-guard";
+            case AtomicAcquire: return "atomic-acquire";
+            case DoubleCheckedLocking: return "double-checked-locking";
+            case CallOnce: return "call-once";
+            case MutexEveryCall: return "mutex-every-call";
+            case UnknownCost: return "unknown";
+        }
+        return "unknown";
+    }
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_ANALYSIS_KINDS_H
@@ -0,0 +1,85 @@
+#ifndef SINGLETON_CHECKER_ANALYZED_REGISTRY_H
+#define SINGLETON_CHECKER_ANALYZED_REGISTRY_H
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ADT/StringSet.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/xxhash.h"
+
+#include <mutex>
+#include <string>
+
+namespace SingletonChecker {
+
+// Set of declarations (by USR) already analysed during the build.
+//
+// A header class is seen by every TU that includes it, the registry lets
+// only the first of them analyse it. Threads of one process share the in
+// memory set; separate processes (plugin invocations, driver shards) share
+// the directory, where a claim is the exclusive creation of a marker file.
+// Markers live in a subdirectory per build run: a directory kept from an
+// earlier run does not hide its header declarations from the next one.
+class AnalyzedRegistry
+{
+    std::mutex mutex;
+    llvm::StringSet<> claimed;
+    std::string dir;
+    bool runDir = false;
+
+    bool claimOnDisk(llvm::StringRef usr) const
+    {
+        llvm::SmallString<256> path(dir);
+        llvm::sys::path::append(path, llvm::utohexstr(llvm::xxHash64(usr)));
+
+        int fd;
+        std::error_code ec = llvm::sys::fs::openFileForWrite(path, fd,
+                                                             llvm::sys::fs::CD_CreateNew);
+        // An existing marker means another process owns the declaration.
+        // Other errors make the registry unusable: analyse rather than
+        // lose the report.
+        if (ec)
+            return ec != std::errc::file_exists;
+        llvm::sys::fs::closeFile(fd);
+        return true;
+    }
+
+public:
+    // Processes of the same build pass the same run, an empty run uses the
+    // directory itself, which then has to be emptied before each build.
+    explicit AnalyzedRegistry(llvm::StringRef dir = "", llvm::StringRef run = "")
+    {
+        if (dir.empty())
+            return;
+        llvm::SmallString<256> path(dir);
+        if (!run.empty())
+            llvm::sys::path::append(path, "run-" + run);
+        this->dir = std::string(path.str());
+        runDir = !run.empty();
+        llvm::sys::fs::create_directories(this->dir);
+    }
+
+    // Drops the markers of the run, for a run no other process shares
+    // (e.g. one the driver made up for itself).
+    void removeRun()
+    {
+        if (runDir)
+            llvm::sys::fs::remove_directories(dir);
+    }
+
+    // True for the first caller only.
+    bool claim(llvm::StringRef usr)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!claimed.insert(usr).second) return false;
+        }
+        return dir.empty() || claimOnDisk(usr);
+    }
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_ANALYZED_REGISTRY_H
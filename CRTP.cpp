@@ -18,3 +18,11 @@ class MySingleton : public CRTPSingleton<MySingleton> {
 private:
     MySingleton() {}
 };
+
+// Reuses the analysis of CRTPSingleton made for MySingleton.
+class Config : public CRTPSingleton<Config> {
+    friend class CRTPSingleton<Config>;
+
+private:
+    Config() {}
+};
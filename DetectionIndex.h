@@ -0,0 +1,306 @@
+#ifndef SINGLETON_CHECKER_DETECTION_INDEX_H
+#define SINGLETON_CHECKER_DETECTION_INDEX_H
+
+#include "AnalysisKinds.h"
+#include "FileIO.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SingletonChecker {
+
+// Classes reported by one TU in a fixed size binary form, queried by
+// singleton-query without parsing anything. Locations are a file of the
+// file table and a byte offset, not printed source locations.
+//
+// File layout, little endian, one file per TU:
+//   "SCDET001"
+//   <u32 number of files> <u32 number of detections> <u32 string table size>
+//   per file: <u32 offset> <u32 size> of its path in the string table
+//   per detection, recordSize bytes:
+//     <u32 usr offset> <u32 usr size> <u32 name offset> <u32 name size>
+//     <u32 pattern bits> <u32 flag bits> <u8 condition> <u8 access cost> <u16 0>
+//     class, getInstance and instance field locations: <u32 file> <u32 offset>
+//   string table
+namespace DetectionFormat {
+    static constexpr llvm::StringLiteral magic = "SCDET001";
+    static constexpr size_t headerSize = 8 + 3 * sizeof(uint32_t);
+    static constexpr size_t recordSize = 7 * sizeof(uint32_t) + 3 * 2 * sizeof(uint32_t);
+    static constexpr uint32_t noFile = ~0u;
+
+    // The u8 condition and access cost hold AnalysisKinds values.
+    static_assert(AnalysisKinds::UnknownCondition <= 0xff && AnalysisKinds::MutexEveryCall <= 0xff,
+                  "AnalysisKinds values must fit a byte");
+
+    enum Pattern : uint32_t {
+        Naive       = 1 << 0,
+        Meyers      = 1 << 1,
+        CRTP        = 1 << 2,
+        IfNaive     = 1 << 3,
+        FlagsNaive  = 1 << 4,
+        Unknown     = 1 << 5,
+    };
+
+    enum Flag : uint32_t {
+        CtorsPrivate            = 1 << 0,
+        DeletedCopyConstructor  = 1 << 1,
+        DeletedAssignment       = 1 << 2,
+        HiddenInstanceMethod    = 1 << 3,
+        SkippedByBudget         = 1 << 4,
+        SmartPointerInstance    = 1 << 5,
+        FriendGetInstance       = 1 << 6,
+    };
+
+    // Same names as the JSON reports, in bit order.
+    static constexpr const char* patternNames[] = {
+        "naive", "meyers", "crtp", "if-naive", "flags-naive", "unknown"};
+}
+
+class DetectionIndexBuilder
+{
+public:
+    struct Location {
+        uint32_t file = DetectionFormat::noFile;
+        uint32_t offset = 0;
+    };
+
+    struct Detection {
+        std::string usr;
+        std::string name;
+        uint32_t patterns = 0;
+        uint32_t flags = 0;
+        uint8_t condition = 0;      // AnalysisKinds::ConditionPatternInGetInstance
+        uint8_t accessCost = 0;     // AnalysisKinds::AccessCost
+        Location classLocation;
+        Location getInstance;
+        Location instanceField;
+    };
+
+    unsigned addFile(llvm::StringRef path)
+    {
+        files.push_back(path.str());
+        return files.size() - 1;
+    }
+
+    void add(Detection detection) { detections.push_back(std::move(detection)); }
+    bool empty() const { return detections.empty(); }
+
+    static std::string fileName(llvm::StringRef mainFile)
+    {
+        return llvm::utohexstr(llvm::xxHash64(mainFile)) + ".idx";
+    }
+
+    bool write(llvm::StringRef dir, llvm::StringRef mainFile) const
+    {
+        return writeFile(dir, mainFile, serialize());
+    }
+
+    std::string serialize() const
+    {
+        std::string strings;
+        auto intern = [&](const std::string& value) {
+            uint32_t offset = strings.size();
+            strings += value;
+            return offset;
+        };
+
+        std::string content;
+        llvm::raw_string_ostream os(content);
+        llvm::support::endian::Writer writer(os, llvm::support::little);
+        os << DetectionFormat::magic;
+        writer.write<uint32_t>(files.size());
+        writer.write<uint32_t>(detections.size());
+        size_t sizeAt = os.tell();
+        writer.write<uint32_t>(0);
+        for (const std::string& file : files) {
+            writer.write<uint32_t>(intern(file));
+            writer.write<uint32_t>(file.size());
+        }
+        for (const Detection& detection : detections) {
+            writer.write<uint32_t>(intern(detection.usr));
+            writer.write<uint32_t>(detection.usr.size());
+            writer.write<uint32_t>(intern(detection.name));
+            writer.write<uint32_t>(detection.name.size());
+            writer.write<uint32_t>(detection.patterns);
+            writer.write<uint32_t>(detection.flags);
+            writer.write<uint8_t>(detection.condition);
+            writer.write<uint8_t>(detection.accessCost);
+            writer.write<uint16_t>(0);
+            for (const Location& location : {detection.classLocation, detection.getInstance,
+                                              detection.instanceField}) {
+                writer.write<uint32_t>(location.file);
+                writer.write<uint32_t>(location.offset);
+            }
+        }
+        os << strings;
+        os.flush();
+        llvm::support::endian::write32le(&content[sizeAt], strings.size());
+        return content;
+    }
+
+    // Written atomically, a query never sees a partially written index.
+    // Also used by the driver for the indexes of cached TUs.
+    static bool writeFile(llvm::StringRef dir, llvm::StringRef mainFile, llvm::StringRef content)
+    {
+        llvm::sys::fs::create_directories(dir);
+        llvm::SmallString<256> path(dir);
+        llvm::sys::path::append(path, fileName(mainFile));
+        return writeFileAtomic(path, content);
+    }
+
+private:
+    std::vector<std::string> files;
+    std::vector<Detection> detections;
+};
+
+// Index files of a directory, memory mapped. A detection is decoded from
+// its fixed size record when it is visited, strings are views into the
+// mapping: a query costs one pass over the records and no allocation per
+// detection. Classes reported by several TUs (header classes analysed
+// without a registry) are visited once.
+class DetectionIndex
+{
+public:
+    struct Location {
+        llvm::StringRef file;       // empty if none
+        uint32_t offset = 0;
+    };
+
+    struct Detection {
+        llvm::StringRef usr;
+        llvm::StringRef name;
+        uint32_t patterns;
+        uint32_t flags;
+        uint8_t condition;
+        uint8_t accessCost;
+        Location classLocation;
+        Location getInstance;
+        Location instanceField;
+    };
+
+private:
+    struct IndexFile {
+        MappedFile mapping;
+        std::vector<llvm::StringRef> files;
+        llvm::StringRef records;
+        llvm::StringRef strings;
+    };
+
+    std::vector<IndexFile> indexes;
+    unsigned malformed = 0;
+
+    static llvm::Optional<llvm::StringRef> stringAt(llvm::StringRef strings, const char* field)
+    {
+        uint32_t offset = llvm::support::endian::read32le(field);
+        uint32_t size = llvm::support::endian::read32le(field + sizeof(uint32_t));
+        if (uint64_t(offset) + size > strings.size())
+            return llvm::None;
+        return strings.substr(offset, size);
+    }
+
+    static bool parse(llvm::StringRef data, IndexFile& index)
+    {
+        using namespace llvm::support::endian;
+        if (data.size() < DetectionFormat::headerSize || !data.consume_front(DetectionFormat::magic))
+            return false;
+        uint32_t fileCount = read32le(data.data());
+        uint32_t detectionCount = read32le(data.data() + 4);
+        uint32_t stringsSize = read32le(data.data() + 8);
+        data = data.drop_front(3 * sizeof(uint32_t));
+
+        uint64_t fileTableSize = uint64_t(fileCount) * 2 * sizeof(uint32_t);
+        uint64_t recordsSize = uint64_t(detectionCount) * DetectionFormat::recordSize;
+        if (fileTableSize + recordsSize + stringsSize != data.size())
+            return false;
+        index.strings = data.take_back(stringsSize);
+        index.records = data.substr(fileTableSize, recordsSize);
+        for (uint32_t i = 0; i < fileCount; ++i) {
+            auto file = stringAt(index.strings, data.data() + i * 2 * sizeof(uint32_t));
+            if (!file)
+                return false;
+            index.files.push_back(*file);
+        }
+        return true;
+    }
+
+    static Location locationAt(const IndexFile& index, const char* field)
+    {
+        uint32_t file = llvm::support::endian::read32le(field);
+        if (file >= index.files.size())
+            return {};
+        return {index.files[file], llvm::support::endian::read32le(field + sizeof(uint32_t))};
+    }
+
+public:
+    // False if the file cannot be read. An empty or truncated index counts
+    // as malformed.
+    bool addFile(llvm::StringRef path)
+    {
+        llvm::Optional<MappedFile> file = MappedFile::open(path);
+        if (!file)
+            return false;
+        IndexFile index;
+        if (!parse(file->data(), index)) {
+            ++malformed;
+            return true;
+        }
+        index.mapping = std::move(*file);
+        indexes.push_back(std::move(index));
+        return true;
+    }
+
+    // Adds every *.idx file of dir, in name order; an unreadable one counts
+    // as malformed.
+    void addDirectory(llvm::StringRef dir, std::error_code& ec)
+    {
+        for (const std::string& path : listFiles(dir, ".idx", ec))
+            if (!addFile(path))
+                ++malformed;
+    }
+
+    // Calls visit for every distinct class until it returns false.
+    template<typename Visit>
+    void forEach(Visit visit) const
+    {
+        using llvm::support::endian::read32le;
+        llvm::DenseSet<llvm::StringRef> seen;
+        for (const IndexFile& index : indexes) {
+            for (size_t at = 0; at < index.records.size(); at += DetectionFormat::recordSize) {
+                const char* record = index.records.data() + at;
+                auto usr = stringAt(index.strings, record);
+                auto name = stringAt(index.strings, record + 8);
+                if (!usr || !name || (!usr->empty() && !seen.insert(*usr).second))
+                    continue;
+                Detection detection{*usr, *name, read32le(record + 16), read32le(record + 20),
+                                    uint8_t(record[24]), uint8_t(record[25]),
+                                    locationAt(index, record + 28), locationAt(index, record + 36),
+                                    locationAt(index, record + 44)};
+                if (!visit(detection))
+                    return;
+            }
+        }
+    }
+
+    size_t getIndexes() const { return indexes.size(); }
+    unsigned getMalformed() const { return malformed; }
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_DETECTION_INDEX_H
@@ -0,0 +1,94 @@
+#ifndef SINGLETON_CHECKER_FILE_IO_H
+#define SINGLETON_CHECKER_FILE_IO_H
+
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SingletonChecker {
+
+// Read only mapping of a whole file, for the per-TU files the query tools
+// parse in place. An empty file has empty data and no mapping, its parser
+// rejects it like any other malformed file.
+class MappedFile
+{
+public:
+    // None if the file cannot be opened or mapped.
+    static llvm::Optional<MappedFile> open(llvm::StringRef path)
+    {
+        int fd;
+        if (llvm::sys::fs::openFileForRead(path, fd))
+            return llvm::None;
+        llvm::sys::fs::file_status status;
+        std::error_code ec = llvm::sys::fs::status(fd, status);
+        MappedFile file;
+        if (!ec && status.getSize())
+            file.mapping = std::make_unique<llvm::sys::fs::mapped_file_region>(
+                llvm::sys::fs::convertFDToNativeFile(fd),
+                llvm::sys::fs::mapped_file_region::readonly, status.getSize(), 0, ec);
+        llvm::sys::fs::closeFile(fd);
+        if (ec)
+            return llvm::None;
+        return file;
+    }
+
+    llvm::StringRef data() const
+    {
+        return mapping ? llvm::StringRef(mapping->const_data(), mapping->size()) : llvm::StringRef();
+    }
+
+private:
+    std::unique_ptr<llvm::sys::fs::mapped_file_region> mapping;
+};
+
+// Files of dir with the given extension, in name order so that the output
+// does not depend on the directory listing.
+inline std::vector<std::string> listFiles(llvm::StringRef dir, llvm::StringRef extension,
+                                          std::error_code& ec)
+{
+    std::vector<std::string> paths;
+    for (llvm::sys::fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+        if (llvm::sys::path::extension(it->path()) == extension)
+            paths.push_back(it->path());
+    llvm::sort(paths);
+    return paths;
+}
+
+// Writes a unique file next to path and renames it into place: concurrent
+// runs and the query tools never see a partially written file.
+inline bool writeFileAtomic(llvm::StringRef path, llvm::StringRef content)
+{
+    int fd;
+    llvm::SmallString<256> tmpPath;
+    llvm::SmallString<256> model(llvm::sys::path::parent_path(path));
+    llvm::sys::path::append(model, "tmp-%%%%%%%%");
+    if (llvm::sys::fs::createUniqueFile(model, fd, tmpPath))
+        return false;
+    {
+        llvm::raw_fd_ostream out(fd, /*shouldClose=*/true);
+        out << content;
+        out.close();
+        if (out.has_error()) {
+            out.clear_error();
+            llvm::sys::fs::remove(tmpPath);
+            return false;
+        }
+    }
+    if (llvm::sys::fs::rename(tmpPath, path)) {
+        llvm::sys::fs::remove(tmpPath);
+        return false;
+    }
+    return true;
+}
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_FILE_IO_H
@@ -0,0 +1,201 @@
+#ifndef SINGLETON_CHECKER_INSTANCE_SUMMARY_H
+#define SINGLETON_CHECKER_INSTANCE_SUMMARY_H
+
+#include "FileIO.h"
+#include "llvm/ADT/DenseSet.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SingletonChecker {
+
+// Objects with static storage duration (globals, static data members,
+// static locals) of record type defined by one TU, keyed by the USR of the
+// record. The USR of the object itself tells definitions seen by several
+// TUs (inline variables, static locals of inline functions) apart from
+// distinct objects.
+//
+// File layout, little endian, one file per TU:
+//   "SCINST01"
+//   <u32 number of instances>
+//   per instance four strings: record USR, record name, instance USR,
+//   location; each a <u32 size> followed by the bytes
+class InstanceSummary
+{
+public:
+    struct Instance {
+        std::string recordUSR;
+        std::string recordName;
+        std::string instanceUSR;
+        std::string location;
+    };
+
+    static constexpr llvm::StringLiteral magic = "SCINST01";
+
+    void add(Instance instance) { instances.push_back(std::move(instance)); }
+    bool empty() const { return instances.empty(); }
+
+    static std::string fileName(llvm::StringRef mainFile)
+    {
+        return llvm::utohexstr(llvm::xxHash64(mainFile)) + ".sum";
+    }
+
+    bool write(llvm::StringRef dir, llvm::StringRef mainFile) const
+    {
+        return writeFile(dir, mainFile, serialize());
+    }
+
+    std::string serialize() const
+    {
+        std::string content;
+        llvm::raw_string_ostream os(content);
+        os << magic;
+        llvm::support::endian::Writer writer(os, llvm::support::little);
+        writer.write<uint32_t>(instances.size());
+        for (const Instance& instance : instances) {
+            for (const std::string* field : {&instance.recordUSR, &instance.recordName,
+                                             &instance.instanceUSR, &instance.location}) {
+                writer.write<uint32_t>(field->size());
+                os << *field;
+            }
+        }
+        os.flush();
+        return content;
+    }
+
+    // Written atomically, the merge never sees a partially written summary.
+    // The driver also writes the summaries of cached TUs this way.
+    static bool writeFile(llvm::StringRef dir, llvm::StringRef mainFile, llvm::StringRef content)
+    {
+        llvm::sys::fs::create_directories(dir);
+        llvm::SmallString<256> path(dir);
+        llvm::sys::path::append(path, fileName(mainFile));
+        return writeFileAtomic(path, content);
+    }
+
+private:
+    std::vector<Instance> instances;
+};
+
+// Program wide view of the summaries of a directory. Every summary is
+// memory mapped and parsed in place: records and instances are StringRefs
+// into the mappings, so merging costs one hash lookup per instance and no
+// copies, whatever the number of summaries.
+class InstanceIndex
+{
+public:
+    struct InstanceRef {
+        llvm::StringRef usr;
+        llvm::StringRef location;
+    };
+
+    struct RecordInstances {
+        llvm::StringRef name;
+        std::vector<InstanceRef> instances;
+    };
+
+private:
+    std::vector<MappedFile> mappings;
+    llvm::StringMap<RecordInstances> records;
+    // (record USR, instance USR) pairs already counted.
+    llvm::DenseSet<std::pair<llvm::StringRef, llvm::StringRef>> seen;
+    unsigned summaries = 0;
+    unsigned malformed = 0;
+
+    static bool readString(llvm::StringRef& data, llvm::StringRef& out)
+    {
+        if (data.size() < sizeof(uint32_t)) return false;
+        uint32_t size = llvm::support::endian::read32le(data.data());
+        data = data.drop_front(sizeof(uint32_t));
+        if (data.size() < size) return false;
+        out = data.take_front(size);
+        data = data.drop_front(size);
+        return true;
+    }
+
+    // A summary is merged only once all of it parsed: a truncated one adds
+    // nothing, so it cannot hide the same objects of a later valid summary.
+    bool parse(llvm::StringRef data)
+    {
+        if (!data.consume_front(InstanceSummary::magic) || data.size() < sizeof(uint32_t))
+            return false;
+        uint32_t count = llvm::support::endian::read32le(data.data());
+        data = data.drop_front(sizeof(uint32_t));
+        struct Parsed {
+            llvm::StringRef recordUSR, recordName, instanceUSR, location;
+        };
+        std::vector<Parsed> parsed;
+        for (uint32_t i = 0; i < count; ++i) {
+            Parsed instance;
+            if (!readString(data, instance.recordUSR) || !readString(data, instance.recordName)
+                || !readString(data, instance.instanceUSR) || !readString(data, instance.location))
+                return false;
+            parsed.push_back(instance);
+        }
+        for (const Parsed& instance : parsed) {
+            if (!seen.insert({instance.recordUSR, instance.instanceUSR}).second)
+                continue;
+            RecordInstances& record = records[instance.recordUSR];
+            record.name = instance.recordName;
+            record.instances.push_back({instance.instanceUSR, instance.location});
+        }
+        return true;
+    }
+
+public:
+    // False if the file cannot be read. An empty or truncated summary
+    // counts as malformed.
+    bool addFile(llvm::StringRef path)
+    {
+        llvm::Optional<MappedFile> file = MappedFile::open(path);
+        if (!file)
+            return false;
+        ++summaries;
+        if (!parse(file->data()))
+            ++malformed;
+        // Kept mapped: the index refers to its bytes.
+        mappings.push_back(std::move(*file));
+        return true;
+    }
+
+    // Adds every *.sum file of dir, in name order; an unreadable one counts
+    // as malformed.
+    void addDirectory(llvm::StringRef dir, std::error_code& ec)
+    {
+        for (const std::string& path : listFiles(dir, ".sum", ec))
+            if (!addFile(path))
+                ++malformed;
+    }
+
+    // Records with at least minInstances distinct objects, by record USR.
+    std::vector<const llvm::StringMapEntry<RecordInstances>*>
+    recordsWithInstances(unsigned minInstances) const
+    {
+        std::vector<const llvm::StringMapEntry<RecordInstances>*> result;
+        for (const auto& entry : records)
+            if (entry.second.instances.size() >= minInstances)
+                result.push_back(&entry);
+        llvm::sort(result, [](const auto* lhs, const auto* rhs) { return lhs->first() < rhs->first(); });
+        return result;
+    }
+
+    unsigned getSummaries() const { return summaries; }
+    unsigned getMalformed() const { return malformed; }
+    size_t getRecords() const { return records.size(); }
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_INSTANCE_SUMMARY_H
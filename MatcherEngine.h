@@ -0,0 +1,337 @@
+#ifndef SINGLETON_CHECKER_MATCHER_ENGINE_H
+#define SINGLETON_CHECKER_MATCHER_ENGINE_H
+
+#include "AnalysisData.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringSwitch.h"
+
+#include <vector>
+
+namespace SingletonChecker {
+
+enum class AnalysisEngine {
+    Visitor,    // GetInstancePatternAnalyser walks of every candidate body
+    Matchers,   // all patterns registered in one MatchFinder pass
+    CFG,        // flow-sensitive walks of the CFG of every candidate body
+};
+
+inline llvm::Optional<AnalysisEngine> parseAnalysisEngine(StringRef value)
+{
+    return llvm::StringSwitch<llvm::Optional<AnalysisEngine>>(value)
+        .Case("visitor", AnalysisEngine::Visitor)
+        .Case("matchers", AnalysisEngine::Matchers)
+        .Case("cfg", AnalysisEngine::CFG)
+        .Default(llvm::None);
+}
+
+namespace PatternMatchers {
+
+using namespace clang::ast_matchers;
+
+// ignoringParenImpCasts and friends match expressions only. AST_MATCHER
+// below opens a PatternMatchers::internal, hence the full qualification.
+using ExprMatcher = clang::ast_matchers::internal::Matcher<Expr>;
+
+AST_MATCHER(FunctionDecl, returnsPointerOrReference)
+{
+    QualType type = Node.getReturnType();
+    return type->isPointerType() || type->isReferenceType();
+}
+
+AST_MATCHER(VarDecl, isStaticDataMember)
+{
+    return Node.isStaticDataMember();
+}
+
+// Same signature check as GetInstancePatternAnalyser::isValidSingletonMethodSignature.
+inline DeclarationMatcher getInstanceCandidate()
+{
+    return functionDecl(isDefinition(), returnsPointerOrReference()).bind("func");
+}
+
+inline TypeMatcher smartPointerType()
+{
+    return hasUnqualifiedDesugaredType(recordType(hasDeclaration(
+        cxxRecordDecl(isInStdNamespace(), hasAnyName("unique_ptr", "shared_ptr")))));
+}
+
+inline TypeMatcher atomicType()
+{
+    return hasUnqualifiedDesugaredType(recordType(hasDeclaration(
+        cxxRecordDecl(isInStdNamespace(), hasName("atomic")))));
+}
+
+// Reads of a std::unique_ptr/shared_ptr var (*ptr, ptr.get(), its operator
+// bool) or of a std::atomic var (load(), conversion), as
+// AnalysisAlgorithm::getVarDeclFromExpr.
+inline ExprMatcher wrappedRead(const DeclarationMatcher& var)
+{
+    auto smartPointer = declRefExpr(to(var), hasType(smartPointerType()));
+    auto atomic = declRefExpr(to(var), hasType(atomicType()));
+    return ignoringParenImpCasts(anyOf(
+        cxxOperatorCallExpr(hasOverloadedOperatorName("*"),
+                            hasArgument(0, ignoringParenImpCasts(smartPointer))),
+        cxxMemberCallExpr(on(smartPointer), callee(cxxMethodDecl(anyOf(hasName("get"), cxxConversionDecl())))),
+        cxxMemberCallExpr(on(atomic), callee(cxxMethodDecl(anyOf(hasName("load"), cxxConversionDecl()))))));
+}
+
+// var, &var or *var, as AnalysisAlgorithm::extractVarFromUnary.
+inline ExprMatcher refersTo(const DeclarationMatcher& var)
+{
+    return ignoringParenImpCasts(anyOf(
+        declRefExpr(to(var)),
+        unaryOperator(hasAnyOperatorName("&", "*"),
+                      hasUnaryOperand(ignoringParenImpCasts(declRefExpr(to(var))))),
+        wrappedRead(var)));
+}
+
+// var, !var, var == nullptr, nullptr != var... as analysisCondition of
+// GetInstancePatternAnalyser; the whole condition is bound to "condition".
+inline ExprMatcher conditionOn(const DeclarationMatcher& var)
+{
+    ExprMatcher ref = ignoringParenImpCasts(anyOf(declRefExpr(to(var)), wrappedRead(var)));
+    return ignoringParenImpCasts(expr(anyOf(
+        ref,
+        unaryOperator(hasOperatorName("!"), hasUnaryOperand(ref)),
+        binaryOperator(hasAnyOperatorName("==", "!="), hasEitherOperand(ref),
+                       hasEitherOperand(ignoringParenImpCasts(
+                           anyOf(cxxNullPtrLiteralExpr(), gnuNullExpr())))))).bind("condition"));
+}
+
+// The var a conditional returns, as analyzeConditionalOperator: the one of
+// the true expression, of the false one if the true one names none.
+inline clang::ast_matchers::internal::Matcher<AbstractConditionalOperator> returnsVar(const DeclarationMatcher& var)
+{
+    return anyOf(hasTrueExpression(refersTo(var)),
+                 allOf(hasTrueExpression(unless(refersTo(varDecl()))), hasFalseExpression(refersTo(var))));
+}
+
+} // namespace PatternMatchers
+
+// Alternative to the GetInstancePatternAnalyser walks. Every getInstance
+// pattern is a matcher registered in one MatchFinder, so a single traversal
+// of the TU dispatches all of them; statements nested at any depth of the
+// body are matched, not only the top level ones. The same traversal
+// collects the class and free function candidates, which the visitors
+// then analyse in traversal order with the findings looked up by function.
+// Findings follow the visitor: the last check of a function sets its 
+// condition and flags bit, a conditional returning another var than the
+// one it checks is unknown (flags for a bool check).
+class PatternMatchEngine : public ast_matchers::MatchFinder::MatchCallback
+{
+    ast_matchers::MatchFinder finder;
+    llvm::DenseMap<const FunctionDecl*, AnalysisData> findings;
+    std::vector<Decl*> candidates;
+    std::vector<HotCallSite> loopCalls;
+
+    AnalysisData& dataOf(const FunctionDecl* func)
+    {
+        auto inserted = findings.try_emplace(func->getCanonicalDecl());
+        if (inserted.second)
+            inserted.first->second.clear();
+        return inserted.first->second;
+    }
+
+    // conditionOn only matches these shapes; a var read through a smart 
+    // pointer or an atomic (*ptr, ptr.get(), load()) is a var, as for
+    // analysisCondition.
+    static AnalysisData::ConditionPatternInGetInstance conditionKind(const Expr* condition)
+    {
+        if (isa<UnaryOperator>(condition)) return AnalysisData::UnaryOperatorInCondition;
+        if (isa<BinaryOperator>(condition)) return AnalysisData::BinaryOperatorInConditionNullptr;
+        return AnalysisData::VarInCondition;
+    }
+
+    // Loops around the call up to the enclosing function or lambda, which
+    // becomes the caller; parts of a loop that run once do not count.
+    static unsigned loopDepthOf(ASTContext& context, const CallExpr* call, const FunctionDecl*& caller)
+    {
+        unsigned depth = 0;
+        const Stmt* part = call;
+        DynTypedNode node = DynTypedNode::create(*call);
+        while (true) {
+            DynTypedNodeList parents = context.getParents(node);
+            if (parents.empty())
+                return 0;
+            node = parents[0];
+            if (auto* func = node.get<FunctionDecl>()) {
+                caller = func;
+                return depth;
+            }
+            if (auto* lambda = node.get<LambdaExpr>()) {
+                caller = lambda->getCallOperator();
+                return depth;
+            }
+            // Declarations in between, e.g. the VarDecl of a DeclStmt.
+            const Stmt* stmt = node.get<Stmt>();
+            if (!stmt)
+                continue;
+            if (HotCallSite::runsPerIteration(stmt, part))
+                ++depth;
+            part = stmt;
+        }
+    }
+
+    void run(const ast_matchers::MatchFinder::MatchResult& result) override
+    {
+        const auto& nodes = result.Nodes;
+        if (auto* decl = nodes.getNodeAs<Decl>("candidate")) {
+            candidates.push_back(const_cast<Decl*>(decl));
+            return;
+        }
+        if (auto* call = nodes.getNodeAs<CallExpr>("loop-call")) {
+            HotCallSite site;
+            site.call = call;
+            site.loopDepth = loopDepthOf(*result.Context, call, site.caller);
+            if (site.loopDepth && site.caller)
+                loopCalls.push_back(site);
+            return;
+        }
+
+        auto* func = nodes.getNodeAs<FunctionDecl>("func");
+        if (!func) return;
+        AnalysisData& data = dataOf(func);
+
+        auto* var = const_cast<VarDecl*>(nodes.getNodeAs<VarDecl>("var"));
+        if (auto* condition = nodes.getNodeAs<Expr>("condition"))
+            data.conditionPatternInGetInstance = conditionKind(condition);
+
+        if (nodes.getNodeAs<Stmt>("meyers")) {
+            data.probablyMayersSingletone = true;
+            data.instanceField = var;
+        }
+        else if (nodes.getNodeAs<Stmt>("naive")) {
+            data.probabalyNaiveSingletone = true;
+            data.instanceField = var;
+        }
+        else if (nodes.getNodeAs<Stmt>("flags")) {
+            data.probablyFlagsNaiveSingletone = true;
+        }
+        else if (nodes.getNodeAs<Stmt>("if-naive")) {
+            data.probablyIfNaiveSingletone = true;
+            data.instanceField = var;
+            data.assignmentInIfSinglton = const_cast<BinaryOperator*>(
+                nodes.getNodeAs<BinaryOperator>("assign"));
+        }
+        else if (nodes.getNodeAs<Stmt>("unknown")) {
+            data.unknownPatternSingletone = true;
+        }
+        else if (auto* checked = nodes.getNodeAs<VarDecl>("checked")) {
+            data.probablyFlagsNaiveSingletone = checked->getType()->isBooleanType();
+        }
+    }
+
+public:
+    PatternMatchEngine()
+    {
+        using namespace PatternMatchers;
+
+        // Candidates, in the order the visitor would see them: no template
+        // instantiations and no lambda classes. Static objects only matter
+        // for the instance summary and the startup audit.
+        finder.addMatcher(cxxRecordDecl(isDefinition(), unless(isTemplateInstantiation()),
+                                        unless(isLambda())).bind("candidate"), this);
+        finder.addMatcher(functionDecl(isDefinition(), unless(cxxMethodDecl()),
+                                       unless(isTemplateInstantiation()),
+                                       returnsPointerOrReference()).bind("candidate"), this);
+        finder.addMatcher(varDecl(hasGlobalStorage(), isDefinition(), unless(isInstantiated()))
+                              .bind("candidate"), this);
+
+        // Calls of possible getInstance functions somewhere inside a loop;
+        // whether the loop repeats them is decided in run().
+        finder.addMatcher(callExpr(callee(functionDecl(returnsPointerOrReference())),
+                                   unless(isInTemplateInstantiation()),
+                                   hasAncestor(stmt(anyOf(forStmt(), whileStmt(), doStmt(),
+                                                          cxxForRangeStmt()))))
+                              .bind("loop-call"), this);
+
+        DeclarationMatcher hiddenStaticMember =
+            varDecl(isStaticDataMember(), unless(isPublic())).bind("var");
+
+        // return instance; with a static local (Meyers) or a hidden static member (naive)
+        finder.addMatcher(returnStmt(forFunction(getInstanceCandidate()),
+                                     hasReturnValue(refersTo(varDecl(isStaticLocal()).bind("var"))))
+                              .bind("meyers"), this);
+        finder.addMatcher(returnStmt(forFunction(getInstanceCandidate()),
+                                     hasReturnValue(refersTo(hiddenStaticMember)))
+                              .bind("naive"), this);
+
+        // return instance ? instance : (instance = new T);
+        ExprMatcher ternary = ignoringParenImpCasts(conditionalOperator(
+            hasCondition(conditionOn(varDecl())), returnsVar(hiddenStaticMember)));
+        finder.addMatcher(returnStmt(forFunction(getInstanceCandidate()), hasReturnValue(ternary))
+                              .bind("naive"), this);
+        ExprMatcher localTernary = ignoringParenImpCasts(conditionalOperator(
+            hasCondition(conditionOn(varDecl())), returnsVar(varDecl(isStaticLocal()).bind("var"))));
+        finder.addMatcher(returnStmt(forFunction(getInstanceCandidate()), hasReturnValue(localTernary))
+                              .bind("meyers"), this);
+
+        // return created ? instance : (instance = new T);
+        ExprMatcher flagTernary = ignoringParenImpCasts(conditionalOperator(
+            hasCondition(conditionOn(varDecl(hasType(booleanType())).bind("flag"))),
+            unless(returnsVar(varDecl(equalsBoundNode("flag"))))));
+        finder.addMatcher(returnStmt(forFunction(getInstanceCandidate()), hasReturnValue(flagTernary))
+                              .bind("flags"), this);
+
+        // return <condition we do not understand> ? ... : ...; and
+        // return other ? instance : ...; checking a var it does not return
+        finder.addMatcher(returnStmt(forFunction(getInstanceCandidate()),
+                                     hasReturnValue(ignoringParenImpCasts(conditionalOperator(
+                                         unless(hasCondition(conditionOn(varDecl())))))))
+                              .bind("unknown"), this);
+        ExprMatcher otherTernary = ignoringParenImpCasts(conditionalOperator(
+            hasCondition(conditionOn(varDecl(unless(hasType(booleanType()))).bind("tested"))),
+            unless(returnsVar(varDecl(equalsBoundNode("tested"))))));
+        finder.addMatcher(returnStmt(forFunction(getInstanceCandidate()), hasReturnValue(otherTernary))
+                              .bind("unknown"), this);
+
+        // if (!instance) { ... instance = new T; ... } at any depth of the body
+        StatementMatcher assignToCondition = binaryOperator(
+            hasOperatorName("="),
+            hasLHS(ignoringParenImpCasts(declRefExpr(to(varDecl(equalsBoundNode("var")))))))
+            .bind("assign");
+        finder.addMatcher(ifStmt(forFunction(getInstanceCandidate()),
+                                 hasCondition(conditionOn(
+                                     varDecl(isStaticDataMember(), isPrivate()).bind("var"))),
+                                 hasThen(stmt(anyOf(assignToCondition, hasDescendant(assignToCondition)))))
+                              .bind("if-naive"), this);
+
+        // if (created) ... sets the flags bit, if (instance) ... clears it
+        finder.addMatcher(ifStmt(forFunction(getInstanceCandidate()),
+                                 hasCondition(conditionOn(varDecl().bind("checked"))))
+                              .bind("check"), this);
+    }
+
+    // Only the top level declarations of scope are traversed, the subtrees
+    // the visitor would prune (system headers, files outside the project)
+    // are never entered.
+    void match(ASTContext& context, const std::vector<Decl*>& scope)
+    {
+        findings.clear();
+        candidates.clear();
+        loopCalls.clear();
+        std::vector<Decl*> traversalScope = context.getTraversalScope();
+        context.setTraversalScope(scope);
+        finder.matchAST(context);
+        context.setTraversalScope(traversalScope);
+    }
+
+    const AnalysisData* findingsOf(const FunctionDecl* func) const
+    {
+        auto it = findings.find(func->getCanonicalDecl());
+        return it == findings.end() ? nullptr : &it->second;
+    }
+
+    llvm::ArrayRef<Decl*> getCandidates() const { return candidates; }
+
+    // Calls repeated by a loop, the callee is not known to be a getInstance yet.
+    llvm::ArrayRef<HotCallSite> getLoopCalls() const { return loopCalls; }
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_MATCHER_ENGINE_H
@@ -0,0 +1,456 @@
+#ifndef SINGLETON_CHECKER_REPORT_WRITER_H
+#define SINGLETON_CHECKER_REPORT_WRITER_H
+
+#include "AnalysisData.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <memory>
+
+namespace SingletonChecker {
+
+enum class OutputFormat {
+    Text,       // box drawing report for humans
+    JSONLines,  // one JSON object per detection
+    SARIF,      // SARIF 2.1.0 log, one result per detection
+};
+
+inline llvm::Optional<OutputFormat> parseOutputFormat(StringRef value)
+{
+    return llvm::StringSwitch<llvm::Optional<OutputFormat>>(value)
+        .Case("text", OutputFormat::Text)
+        .Case("jsonl", OutputFormat::JSONLines)
+        .Case("sarif", OutputFormat::SARIF)
+        .Default(llvm::None);
+}
+
+inline StringRef outputFormatName(OutputFormat format)
+{
+    switch (format) {
+        case OutputFormat::Text: return "text";
+        case OutputFormat::JSONLines: return "jsonl";
+        case OutputFormat::SARIF: return "sarif";
+    }
+    return "text";
+}
+
+// Qualified name and parameter types, e.g. "Logger::Logger(const Config &)".
+inline std::string constructorSignature(const CXXConstructorDecl* ctor)
+{
+    std::string signature = ctor->getQualifiedNameAsString() + "(";
+    for (const ParmVarDecl* param : ctor->parameters()) {
+        if (param->getFunctionScopeIndex()) signature += ", ";
+        signature += param->getType().getAsString();
+    }
+    return signature + ")";
+}
+
+// Output backend. Records are written one by one into the stream of the
+// TU (or of a header declaration); writeDocument() wraps the records of
+// one or more TUs into the final output.
+class ReportWriter
+{
+public:
+    virtual ~ReportWriter() = default;
+
+    virtual void writeClass(llvm::raw_ostream& os, const AnalysisData& data) = 0;
+    virtual void writeFunction(llvm::raw_ostream& os, const FunctionDecl* func,
+                               const AnalysisData& data, const SourceManager& SM) = 0;
+    virtual void writeHotCallSite(llvm::raw_ostream& os, const HotCallSite& site,
+                                  const SourceManager& SM) = 0;
+    virtual void writeStartupInit(llvm::raw_ostream& os, const StartupInit& init,
+                                  const SourceManager& SM) = 0;
+
+    virtual void writeDocument(llvm::raw_ostream& os, StringRef records) { os << records; }
+
+    static std::unique_ptr<ReportWriter> create(OutputFormat format);
+};
+
+class TextReportWriter : public ReportWriter
+{
+public:
+    void writeClass(llvm::raw_ostream& os, const AnalysisData& data) override
+    {
+        data.dump(os);
+    }
+
+    void writeFunction(llvm::raw_ostream& OS, const FunctionDecl* func,
+                       const AnalysisData& analysisData, const SourceManager& SM) override
+    {
+        OS << "\n";
+        OS << "╔══════════════════════════════════════════════════════════════════╗\n";
+        OS << "║                     FUNCTION ANALYSIS REPORT                     ║\n";
+        OS << "╠══════════════════════════════════════════════════════════════════╣\n";
+
+        OS << "║ Function: " << func->getNameAsString() << "\n";
+        OS << "║ Location: " << func->getLocation().printToString(SM) << "\n";
+        OS << "║ Return type: " << func->getReturnType().getAsString() << "\n";
+        OS << "║ Is static: " << (func->isStatic() ? "✓ YES" : "✗ NO") << "\n";
+        OS << "║ Is global: " << (func->isGlobal() ? "✓ YES" : "✗ NO") << "\n";
+
+        OS << "╠══════════════════════════════════════════════════════════════════╣\n";
+        OS << "║ Singleton Pattern Analysis:\n";
+
+        if (analysisData.skippedByBudget) {
+            OS << "║ Pattern: skipped (budget)\n";
+        } else if (analysisData.probabalyNaiveSingletone) {
+            OS << "║ Pattern: Naive Singleton\n";
+        } else if (analysisData.probablyMayersSingletone) {
+            OS << "║ Pattern: Meyer's Singleton\n";
+        } else if (analysisData.probablyIfNaiveSingletone) {
+            OS << "║ Pattern: If-Naive Singleton\n";
+        } else if (analysisData.probablyFlagsNaiveSingletone) {
+            OS << "║ Pattern: Flags-Naive Singleton\n";
+        } else {
+            OS << "║ Pattern: Unknown\n";
+        }
+        OS << "║ Access cost: " << AnalysisData::accessCostName(analysisData.accessCost) << "\n";
+        OS << "║ • Potential getInstance function ✓ YES" << "\n";
+
+
+        OS << "╚══════════════════════════════════════════════════════════════════╝\n";
+        OS << "\n";
+    }
+
+    void writeHotCallSite(llvm::raw_ostream& OS, const HotCallSite& site,
+                          const SourceManager& SM) override
+    {
+        OS << "\n";
+        OS << "╔══════════════════════════════════════════════════════════════════╗\n";
+        OS << "║                  GETINSTANCE CALL INSIDE A LOOP                  ║\n";
+        OS << "╠══════════════════════════════════════════════════════════════════╣\n";
+
+        OS << "║ Call: " << site.getInstance->getQualifiedNameAsString() << "\n";
+        OS << "║ Location: " << site.call->getBeginLoc().printToString(SM) << "\n";
+        OS << "║ Caller: " << site.caller->getQualifiedNameAsString() << "\n";
+        OS << "║ Loop depth: " << site.loopDepth << "\n";
+        OS << "║ • Hoisting candidate ✓ YES" << "\n";
+
+        OS << "╚══════════════════════════════════════════════════════════════════╝\n";
+        OS << "\n";
+    }
+
+    void writeStartupInit(llvm::raw_ostream& OS, const StartupInit& init,
+                          const SourceManager& SM) override
+    {
+        OS << "\n";
+        OS << "╔══════════════════════════════════════════════════════════════════╗\n";
+        OS << "║                STATIC INITIALIZATION BEFORE MAIN                 ║\n";
+        OS << "╠══════════════════════════════════════════════════════════════════╣\n";
+
+        OS << "║ Instance: " << init.instance->getQualifiedNameAsString() << "\n";
+        OS << "║ Location: " << init.instance->getLocation().printToString(SM) << "\n";
+        OS << "║ Singleton: " << init.singleton->getQualifiedNameAsString() << "\n";
+        OS << "║ Dynamic initialization: " << (init.dynamicInit ? "✓ YES" : "✗ NO") << "\n";
+        if (init.constructor) {
+            OS << "║ Constructor: " << constructorSignature(init.constructor) << "\n";
+            OS << "║ Non-trivial constructor: " << (!init.constructor->isTrivial() ? "✓ YES" : "✗ NO") << "\n";
+        }
+        OS << "║ Destructor registered at exit: " << (init.registersDestructor ? "✓ YES" : "✗ NO") << "\n";
+
+        OS << "╚══════════════════════════════════════════════════════════════════╝\n";
+        OS << "\n";
+    }
+};
+
+// Shared by the JSON based backends.
+class JSONRecordBuilder
+{
+protected:
+    static llvm::SmallVector<StringRef, 6> patternNames(const AnalysisData& data)
+    {
+        llvm::SmallVector<StringRef, 6> names;
+        if (data.probabalyNaiveSingletone)     names.push_back("naive");
+        if (data.probablyMayersSingletone)     names.push_back("meyers");
+        if (data.probabalyCRTPSingletone)      names.push_back("crtp");
+        if (data.probablyIfNaiveSingletone)    names.push_back("if-naive");
+        if (data.probablyFlagsNaiveSingletone) names.push_back("flags-naive");
+        if (data.unknownPatternSingletone)     names.push_back("unknown");
+        return names;
+    }
+
+    static StringRef accessName(AccessSpecifier access)
+    {
+        switch (access) {
+            case AS_public: return "public";
+            case AS_protected: return "protected";
+            case AS_private: return "private";
+            case AS_none: return "none";
+        }
+        return "none";
+    }
+
+    static void writeLocation(llvm::json::OStream& J, const SourceManager& SM, SourceLocation loc)
+    {
+        PresumedLoc PL = SM.getPresumedLoc(SM.getExpansionLoc(loc));
+        if (PL.isInvalid()) return;
+        J.attribute("file", PL.getFilename());
+        J.attribute("line", PL.getLine());
+        J.attribute("column", PL.getColumn());
+    }
+
+    static void writeDecl(llvm::json::OStream& J, StringRef key, const NamedDecl* decl,
+                          const SourceManager& SM)
+    {
+        if (!decl) return;
+        J.attributeObject(key, [&] {
+            J.attribute("name", decl->getNameAsString());
+            J.attribute("access", accessName(decl->getAccess()));
+            writeLocation(J, SM, decl->getLocation());
+        });
+    }
+
+    static void writeClassProperties(llvm::json::OStream& J, const AnalysisData& data)
+    {
+        const SourceManager& SM = *data.SM;
+        J.attributeArray("patterns", [&] {
+            for (StringRef name : patternNames(data)) J.value(name);
+        });
+        J.attribute("ctorsPrivate", bool(data.ctorsPrivate));
+        J.attribute("deletedCopyConstructor", bool(data.hasDeletedCopyConstuctor));
+        J.attribute("deletedAssignment", bool(data.hasDeletedAssigmentOperator));
+        J.attribute("instances", unsigned(data.amountObjects));
+        J.attribute("hiddenInstanceMethod", bool(data.hiddenInstanceMethod));
+        if (data.skippedByBudget)
+            J.attribute("skipped", "budget");
+        J.attribute("condition", AnalysisData::conditionName(data.conditionPatternInGetInstance));
+        J.attribute("accessCost", AnalysisData::accessCostName(data.accessCost));
+        if (data.smartPointerInstance)
+            J.attribute("smartPointerInstance", true);
+        writeDecl(J, "getInstance", data.methodLikeGetInstance, SM);
+        if (data.crtpBase)
+            J.attribute("crtpBase", data.crtpBaseName());
+        writeDecl(J, "friendGetInstance", data.friendFunctionLikeGetInstance, SM);
+        writeDecl(J, "instanceField", data.instanceField, SM);
+    }
+
+    static void writeFunctionProperties(llvm::json::OStream& J, const FunctionDecl* func,
+                                        const AnalysisData& data)
+    {
+        J.attribute("returnType", func->getReturnType().getAsString());
+        if (data.skippedByBudget)
+            J.attribute("skipped", "budget");
+        J.attributeArray("patterns", [&] {
+            for (StringRef name : patternNames(data)) J.value(name);
+        });
+        J.attribute("accessCost", AnalysisData::accessCostName(data.accessCost));
+        if (data.smartPointerInstance)
+            J.attribute("smartPointerInstance", true);
+    }
+
+    static void writeHotCallSiteProperties(llvm::json::OStream& J, const HotCallSite& site)
+    {
+        J.attribute("getInstance", site.getInstance->getQualifiedNameAsString());
+        J.attribute("caller", site.caller->getQualifiedNameAsString());
+        J.attribute("loopDepth", site.loopDepth);
+    }
+
+    static void writeStartupInitProperties(llvm::json::OStream& J, const StartupInit& init)
+    {
+        J.attribute("singleton", init.singleton->getQualifiedNameAsString());
+        J.attribute("dynamicInit", init.dynamicInit);
+        J.attribute("registersDestructor", init.registersDestructor);
+        if (init.constructor) {
+            J.attributeObject("constructor", [&] {
+                J.attribute("signature", constructorSignature(init.constructor));
+                J.attribute("nonTrivial", !init.constructor->isTrivial());
+                J.attribute("constexpr", init.constructor->isConstexpr());
+            });
+        }
+    }
+
+    // Records are built in a local buffer and written with a single call.
+    template<typename Build>
+    static void emitLine(llvm::raw_ostream& os, Build build)
+    {
+        llvm::SmallString<512> buffer;
+        llvm::raw_svector_ostream bufferOS(buffer);
+        llvm::json::OStream J(bufferOS);
+        build(J);
+        buffer.push_back('\n');
+        os << buffer;
+    }
+};
+
+class JSONLinesReportWriter : public ReportWriter, JSONRecordBuilder
+{
+public:
+    void writeClass(llvm::raw_ostream& os, const AnalysisData& data) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            J.object([&] {
+                J.attribute("kind", "class");
+                J.attribute("name", data.className);
+                writeLocation(J, *data.SM, data.location);
+                writeClassProperties(J, data);
+            });
+        });
+    }
+
+    void writeFunction(llvm::raw_ostream& os, const FunctionDecl* func,
+                       const AnalysisData& data, const SourceManager& SM) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            J.object([&] {
+                J.attribute("kind", "function");
+                J.attribute("name", func->getNameAsString());
+                writeLocation(J, SM, func->getLocation());
+                writeFunctionProperties(J, func, data);
+            });
+        });
+    }
+
+    void writeHotCallSite(llvm::raw_ostream& os, const HotCallSite& site,
+                          const SourceManager& SM) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            J.object([&] {
+                J.attribute("kind", "hot-call");
+                writeLocation(J, SM, site.call->getBeginLoc());
+                writeHotCallSiteProperties(J, site);
+            });
+        });
+    }
+
+    void writeStartupInit(llvm::raw_ostream& os, const StartupInit& init,
+                          const SourceManager& SM) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            J.object([&] {
+                J.attribute("kind", "startup");
+                J.attribute("name", init.instance->getQualifiedNameAsString());
+                writeLocation(J, SM, init.instance->getLocation());
+                writeStartupInitProperties(J, init);
+            });
+        });
+    }
+};
+
+// Each record is a SARIF result on its own line; writeDocument() adds the
+// log envelope around the results of all TUs.
+class SARIFReportWriter : public ReportWriter, JSONRecordBuilder
+{
+    static void writeResult(llvm::json::OStream& J, StringRef ruleId, const std::string& message,
+                            const SourceManager& SM, SourceLocation loc,
+                            llvm::function_ref<void()> properties)
+    {
+        J.object([&] {
+            J.attribute("ruleId", ruleId);
+            J.attribute("level", "note");
+            J.attributeObject("message", [&] { J.attribute("text", message); });
+            PresumedLoc PL = SM.getPresumedLoc(SM.getExpansionLoc(loc));
+            if (PL.isValid()) {
+                J.attributeArray("locations", [&] {
+                    J.object([&] {
+                        J.attributeObject("physicalLocation", [&] {
+                            J.attributeObject("artifactLocation", [&] {
+                                J.attribute("uri", PL.getFilename());
+                            });
+                            J.attributeObject("region", [&] {
+                                J.attribute("startLine", PL.getLine());
+                                J.attribute("startColumn", PL.getColumn());
+                            });
+                        });
+                    });
+                });
+            }
+            J.attributeObject("properties", properties);
+        });
+    }
+
+    // Records whose analysis stopped at the node budget carry no verdict:
+    // they get a rule of their own instead of the detection message.
+    static constexpr const char* skippedRule = "singleton-analysis-skipped";
+
+public:
+    void writeClass(llvm::raw_ostream& os, const AnalysisData& data) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            if (data.skippedByBudget)
+                writeResult(J, skippedRule, 
+                            "Class '" + data.className + "' was not fully analysed: a body exceeded the node budget",
+                            *data.SM, data.location, [&] { writeClassProperties(J, data); });
+            else
+                writeResult(J, "singleton-class", "Class '" + data.className + "' is likely a singleton",
+                            *data.SM, data.location, [&] { writeClassProperties(J, data); });
+        });
+    }
+
+    void writeFunction(llvm::raw_ostream& os, const FunctionDecl* func,
+                       const AnalysisData& data, const SourceManager& SM) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            if (data.skippedByBudget)
+                writeResult(J, skippedRule,
+                            "Function '" + func->getNameAsString() + "' was not fully analysed: its body exceeded the node budget",
+                            SM, func->getLocation(), [&] { writeFunctionProperties(J, func, data); });
+            else
+                writeResult(J, "singleton-function",
+                            "Function '" + func->getNameAsString() + "' is likely a getInstance function",
+                            SM, func->getLocation(), [&] { writeFunctionProperties(J, func, data); });
+        });
+    }
+
+    void writeHotCallSite(llvm::raw_ostream& os, const HotCallSite& site,
+                          const SourceManager& SM) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            writeResult(J, "singleton-hot-call",
+                        "'" + site.getInstance->getQualifiedNameAsString() + "' is called inside "
+                            + std::to_string(site.loopDepth) + " nested loop(s), consider hoisting it",
+                        SM, site.call->getBeginLoc(), [&] { writeHotCallSiteProperties(J, site); });
+        });
+    }
+
+    void writeStartupInit(llvm::raw_ostream& os, const StartupInit& init,
+                          const SourceManager& SM) override
+    {
+        emitLine(os, [&](llvm::json::OStream& J) {
+            writeResult(J, "singleton-startup-init",
+                        "'" + init.instance->getQualifiedNameAsString() + "' of singleton '"
+                            + init.singleton->getQualifiedNameAsString() + "' runs code before main",
+                        SM, init.instance->getLocation(), [&] { writeStartupInitProperties(J, init); });
+        });
+    }
+
+    void writeDocument(llvm::raw_ostream& os, StringRef records) override
+    {
+        os << "{\"version\":\"2.1.0\","
+              "\"$schema\":\"https://json.schemastore.org/sarif-2.1.0.json\","
+              "\"runs\":[{\"tool\":{\"driver\":{\"name\":\"singleton-checker\",\"rules\":["
+              "{\"id\":\"singleton-class\",\"shortDescription\":{\"text\":\"Singleton class\"}},"
+              "{\"id\":\"singleton-function\",\"shortDescription\":{\"text\":\"getInstance function\"}},"
+              "{\"id\":\"singleton-hot-call\",\"shortDescription\":{\"text\":\"getInstance call inside a loop\"}},"
+              "{\"id\":\"singleton-startup-init\",\"shortDescription\":{\"text\":\"Singleton instance initialized before main\"}},"
+              "{\"id\":\"singleton-analysis-skipped\",\"shortDescription\":{\"text\":\"Analysis stopped at the node budget\"}}"
+              "]}},\"results\":[\n";
+        bool first = true;
+        while (!records.empty()) {
+            StringRef record;
+            std::tie(record, records) = records.split('\n');
+            if (record.empty()) continue;
+            if (!first) os << ",\n";
+            os << record;
+            first = false;
+        }
+        os << "\n]}]}\n";
+    }
+};
+
+inline std::unique_ptr<ReportWriter> ReportWriter::create(OutputFormat format)
+{
+    switch (format) {
+        case OutputFormat::JSONLines: return std::make_unique<JSONLinesReportWriter>();
+        case OutputFormat::SARIF: return std::make_unique<SARIFReportWriter>();
+        case OutputFormat::Text: break;
+    }
+    return std::make_unique<TextReportWriter>();
+}
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_REPORT_WRITER_H
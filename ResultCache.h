@@ -0,0 +1,298 @@
+#ifndef SINGLETON_CHECKER_RESULT_CACHE_H
+#define SINGLETON_CHECKER_RESULT_CACHE_H
+
+#include "FileIO.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Support/xxhash.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace SingletonChecker {
+
+// On-disk cache of per-TU reports for the standalone driver.
+//
+// An entry is keyed by the compile command (file, directory, arguments and
+// checker options) and records the content hash of every file the TU read,
+// main file and transitive includes. A lookup re-hashes those files, so a
+// hit means the TU would be parsed from exactly the same input and it is
+// not parsed at all.
+//
+// Header declarations are analysed by one TU of the build (see
+// AnalyzedRegistry), so their reports are entries of their own, keyed by
+// USR and validated by the files of the TU that analysed them. A TU entry
+// lists the header USRs it reports on and is a hit only if all of them are.
+//
+// Entry layout:
+//   singleton-checker-cache v5
+//   <number of dependencies>
+//   <hex content hash> <absolute path>       (one line per dependency)
+// then for a TU:
+//   <number of header USRs>
+//   <USR>                                    (one line per header USR)
+//   <main file size> <instance summary size> <detection index size>
+//   <main file><instance summary><detection index>
+//   <report until the end of file>
+// or for a header declaration:
+//   <report until the end of file>
+class ResultCache
+{
+    static constexpr llvm::StringLiteral magic = "singleton-checker-cache v5";
+
+    std::string dir;
+    uint64_t maxSizeBytes;
+
+    // Headers are shared by most TUs, hash each of them once per run.
+    std::mutex hashesMutex;
+    llvm::StringMap<llvm::Optional<uint64_t>> contentHashes;
+
+    std::atomic<unsigned> hits{0};
+    std::atomic<unsigned> misses{0};
+
+    std::string entryPath(llvm::StringRef key) const
+    {
+        llvm::SmallString<256> path(dir);
+        // pruneCache() only considers files with this prefix.
+        llvm::sys::path::append(path, "llvmcache-" + key);
+        return std::string(path.str());
+    }
+
+    static std::string headerKey(llvm::StringRef usr, llvm::StringRef options)
+    {
+        return makeKey(usr, "", {}, (options + ";header").str());
+    }
+
+    llvm::Optional<uint64_t> contentHash(llvm::StringRef path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(hashesMutex);
+            auto it = contentHashes.find(path);
+            if (it != contentHashes.end()) return it->second;
+        }
+
+        llvm::Optional<uint64_t> hash;
+        if (auto buffer = llvm::MemoryBuffer::getFile(path, /*IsText=*/false,
+                                                      /*RequiresNullTerminator=*/false))
+            hash = llvm::xxHash64((*buffer)->getBuffer());
+
+        std::lock_guard<std::mutex> lock(hashesMutex);
+        contentHashes[path] = hash;
+        return hash;
+    }
+
+    // Entry whose dependencies are unchanged, without the dependency list.
+    std::unique_ptr<llvm::MemoryBuffer> open(llvm::StringRef key, llvm::StringRef& rest)
+    {
+        std::string path = entryPath(key);
+        auto fd = llvm::sys::fs::openNativeFileForRead(path);
+        if (!fd) {
+            llvm::consumeError(fd.takeError());
+            return nullptr;
+        }
+        auto buffer = llvm::MemoryBuffer::getOpenFile(*fd, path, /*FileSize=*/-1,
+                                                      /*RequiresNullTerminator=*/false);
+        if (!buffer) {
+            llvm::sys::fs::closeFile(*fd);
+            return nullptr;
+        }
+        // Recently used entries survive size based pruning.
+        llvm::sys::fs::setLastAccessAndModificationTime(*fd, std::chrono::system_clock::now());
+        llvm::sys::fs::closeFile(*fd);
+
+        rest = (*buffer)->getBuffer();
+        llvm::StringRef line;
+        std::tie(line, rest) = rest.split('\n');
+        if (line != magic)
+            return nullptr;
+        unsigned numDeps = 0;
+        std::tie(line, rest) = rest.split('\n');
+        if (line.getAsInteger(10, numDeps))
+            return nullptr;
+
+        for (unsigned i = 0; i < numDeps; ++i) {
+            std::tie(line, rest) = rest.split('\n');
+            llvm::StringRef hashStr, depPath;
+            std::tie(hashStr, depPath) = line.split(' ');
+            uint64_t expected = 0;
+            llvm::Optional<uint64_t> actual = contentHash(depPath);
+            if (hashStr.getAsInteger(16, expected) || !actual || *actual != expected)
+                return nullptr;
+        }
+        return std::move(*buffer);
+    }
+
+    // Writes magic and dependencies, false if a dependency is gone already:
+    // the entry could never be validated.
+    bool writeDependencies(llvm::raw_ostream& os, llvm::ArrayRef<std::string> dependencies)
+    {
+        os << magic << '\n' << dependencies.size() << '\n';
+        for (const std::string& dep : dependencies) {
+            llvm::Optional<uint64_t> hash = contentHash(dep);
+            if (!hash) return false;
+            os << llvm::utohexstr(*hash) << ' ' << dep << '\n';
+        }
+        return true;
+    }
+
+    // Written atomically, concurrent runs never see a partially written
+    // entry.
+    void write(llvm::StringRef key, llvm::StringRef content) const
+    {
+        writeFileAtomic(entryPath(key), content);
+    }
+
+public:
+    struct Entry {
+        std::string report;
+        // USRs of the in-scope header declarations the TU reports on,
+        // whichever TU analysed them.
+        std::vector<std::string> headerUSRs;
+        // Their reports, by USR, filled by lookup(); empty ones are left out.
+        std::vector<std::pair<std::string, std::string>> headerReports;
+        // Side outputs of the TU, written again on a hit.
+        std::string mainFile;
+        std::string instanceSummary;
+        std::string detectionIndex;
+    };
+
+    ResultCache(llvm::StringRef dir, uint64_t maxSizeBytes)
+        : dir(dir.str()), maxSizeBytes(maxSizeBytes)
+    {
+        llvm::sys::fs::create_directories(dir);
+    }
+
+    static std::string makeKey(llvm::StringRef file, llvm::StringRef directory,
+                               llvm::ArrayRef<std::string> arguments,
+                               llvm::StringRef options)
+    {
+        std::string key;
+        llvm::raw_string_ostream os(key);
+        os << magic << '\0' << file << '\0' << directory << '\0' << options << '\0';
+        for (const std::string& arg : arguments)
+            os << arg << '\0';
+        return llvm::utohexstr(llvm::xxHash64(os.str()));
+    }
+
+    // Report of a header declaration, empty if it has none.
+    llvm::Optional<std::string> lookupHeader(llvm::StringRef usr, llvm::StringRef options)
+    {
+        llvm::StringRef rest;
+        if (!open(headerKey(usr, options), rest))
+            return llvm::None;
+        return rest.str();
+    }
+
+    llvm::Optional<Entry> lookup(llvm::StringRef key, llvm::StringRef options)
+    {
+        llvm::Optional<Entry> entry = read(key, options);
+        ++(entry ? hits : misses);
+        return entry;
+    }
+
+    void store(llvm::StringRef key, llvm::ArrayRef<std::string> dependencies,
+               const Entry& entry)
+    {
+        std::string content;
+        llvm::raw_string_ostream os(content);
+        if (!writeDependencies(os, dependencies))
+            return;
+        os << entry.headerUSRs.size() << '\n';
+        for (const std::string& usr : entry.headerUSRs)
+            os << usr << '\n';
+        os << entry.mainFile.size() << ' ' << entry.instanceSummary.size() << ' '
+           << entry.detectionIndex.size() << '\n'
+           << entry.mainFile << entry.instanceSummary << entry.detectionIndex;
+        os << entry.report;
+        os.flush();
+        write(key, content);
+    }
+
+    // Report of a header declaration analysed by a TU with these dependencies.
+    void storeHeader(llvm::StringRef usr, llvm::StringRef options,
+                     llvm::ArrayRef<std::string> dependencies, llvm::StringRef report)
+    {
+        std::string content;
+        llvm::raw_string_ostream os(content);
+        if (!writeDependencies(os, dependencies))
+            return;
+        os << report;
+        os.flush();
+        write(headerKey(usr, options), content);
+    }
+
+    // Drops least recently used entries until the directory fits maxSizeBytes.
+    void prune() const
+    {
+        llvm::CachePruningPolicy policy;
+        policy.Interval = std::chrono::seconds(0);
+        policy.Expiration = std::chrono::seconds(0);
+        policy.MaxSizePercentageOfAvailableSpace = 0;
+        policy.MaxSizeBytes = maxSizeBytes;
+        llvm::pruneCache(dir, policy);
+    }
+
+    unsigned getHits() const { return hits; }
+    unsigned getMisses() const { return misses; }
+
+private:
+    llvm::Optional<Entry> read(llvm::StringRef key, llvm::StringRef options)
+    {
+        llvm::StringRef rest;
+        std::unique_ptr<llvm::MemoryBuffer> buffer = open(key, rest);
+        if (!buffer)
+            return llvm::None;
+
+        Entry entry;
+        llvm::StringRef line;
+        unsigned numHeaderUSRs = 0;
+        std::tie(line, rest) = rest.split('\n');
+        if (line.getAsInteger(10, numHeaderUSRs))
+            return llvm::None;
+        for (unsigned i = 0; i < numHeaderUSRs; ++i) {
+            std::tie(line, rest) = rest.split('\n');
+            entry.headerUSRs.push_back(line.str());
+        }
+
+        std::string* sides[] = {&entry.mainFile, &entry.instanceSummary, &entry.detectionIndex};
+        llvm::SmallVector<llvm::StringRef, 3> sideSizes;
+        std::tie(line, rest) = rest.split('\n');
+        line.split(sideSizes, ' ');
+        if (sideSizes.size() != std::size(sides))
+            return llvm::None;
+        for (size_t i = 0; i < sideSizes.size(); ++i) {
+            size_t len = 0;
+            if (sideSizes[i].getAsInteger(10, len) || rest.size() < len)
+                return llvm::None;
+            *sides[i] = rest.take_front(len).str();
+            rest = rest.drop_front(len);
+        }
+        entry.report = rest.str();
+
+        // The analysing TU stored the report; until it did (or if its files
+        // changed since) this TU is analysed again.
+        for (const std::string& usr : entry.headerUSRs) {
+            llvm::Optional<std::string> report = lookupHeader(usr, options);
+            if (!report)
+                return llvm::None;
+            if (!report->empty())
+                entry.headerReports.emplace_back(usr, std::move(*report));
+        }
+        return entry;
+    }
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_RESULT_CACHE_H
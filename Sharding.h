@@ -0,0 +1,226 @@
+#ifndef SINGLETON_CHECKER_SHARDING_H
+#define SINGLETON_CHECKER_SHARDING_H
+
+#include "FileIO.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace SingletonChecker {
+
+// Analysis time of each TU in previous runs, the cost model of the shard
+// plan. Text file, one "<milliseconds>\t<path>" line per TU, in path order.
+class TimingTable
+{
+    llvm::StringMap<double> milliseconds;
+
+public:
+    // A missing file is an empty table: the first run has no history.
+    bool read(llvm::StringRef path)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer)
+            return buffer.getError() == std::errc::no_such_file_or_directory;
+        llvm::SmallVector<llvm::StringRef, 0> lines;
+        (*buffer)->getBuffer().split(lines, '\n', -1, /*KeepEmpty=*/false);
+        for (llvm::StringRef line : lines) {
+            llvm::StringRef time, file;
+            std::tie(time, file) = line.split('\t');
+            double value;
+            if (file.empty() || time.getAsDouble(value) || value < 0)
+                return false;
+            milliseconds[file] = value;
+        }
+        return true;
+    }
+
+    bool write(llvm::StringRef path) const
+    {
+        std::vector<llvm::StringRef> files;
+        for (const auto& entry : milliseconds)
+            files.push_back(entry.first());
+        llvm::sort(files);
+        std::string content;
+        llvm::raw_string_ostream os(content);
+        for (llvm::StringRef file : files)
+            os << llvm::format("%.1f", milliseconds.lookup(file)) << "\t" << file << "\n";
+        os.flush();
+        return writeFileAtomic(path, content);
+    }
+
+    void set(llvm::StringRef file, double value) { milliseconds[file] = value; }
+    bool empty() const { return milliseconds.empty(); }
+
+    llvm::Optional<double> lookup(llvm::StringRef file) const
+    {
+        auto it = milliseconds.find(file);
+        if (it == milliseconds.end())
+            return llvm::None;
+        return it->second;
+    }
+
+    // Files without history cost the mean of the known ones, or 1 when
+    // nothing is known, which degrades to an even split by count.
+    std::vector<double> costsOf(llvm::ArrayRef<std::string> files) const
+    {
+        double known = 0;
+        unsigned count = 0;
+        for (const std::string& file : files)
+            if (llvm::Optional<double> value = lookup(file)) {
+                known += *value;
+                ++count;
+            }
+        double fallback = count ? known / count : 1;
+        std::vector<double> costs;
+        for (const std::string& file : files)
+            costs.push_back(lookup(file).getValueOr(fallback));
+        return costs;
+    }
+};
+
+// "<index>/<count>", index from 0.
+struct ShardSpec {
+    unsigned index = 0;
+    unsigned count = 1;
+
+    static llvm::Optional<ShardSpec> parse(llvm::StringRef value)
+    {
+        llvm::StringRef index, count;
+        std::tie(index, count) = value.split('/');
+        ShardSpec spec;
+        if (index.getAsInteger(10, spec.index) || count.getAsInteger(10, spec.count)
+            || spec.count == 0 || spec.index >= spec.count)
+            return llvm::None;
+        return spec;
+    }
+};
+
+// Shard of every file, greedy longest processing time first: the most
+// expensive TU goes to the least loaded shard. Ties are broken by path and
+// shard number, so every shard process computes the same plan from the
+// same file list and timings.
+inline std::vector<unsigned> planShards(llvm::ArrayRef<std::string> files,
+                                        llvm::ArrayRef<double> costs, unsigned count)
+{
+    std::vector<size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    llvm::stable_sort(order, [&](size_t lhs, size_t rhs) {
+        if (costs[lhs] != costs[rhs])
+            return costs[lhs] > costs[rhs];
+        return files[lhs] < files[rhs];
+    });
+
+    std::vector<double> loads(count, 0);
+    std::vector<unsigned> shards(files.size());
+    for (size_t file : order) {
+        unsigned lightest = std::min_element(loads.begin(), loads.end()) - loads.begin();
+        shards[file] = lightest;
+        loads[lightest] += costs[file];
+    }
+    return shards;
+}
+
+// What one shard hands to singleton-merge: the undecorated records of its
+// TUs and header declarations, and the measured analysis times.
+struct ShardResult {
+    struct FileReport {
+        std::string path;
+        std::string report;
+        double milliseconds = -1;   // negative if not analysed (cache hit, failure)
+    };
+
+    std::string format;
+    std::vector<FileReport> files;
+    std::vector<std::pair<std::string, std::string>> headerReports;
+    unsigned failures = 0;
+
+    bool write(llvm::StringRef path) const
+    {
+        std::string content;
+        llvm::raw_string_ostream os(content);
+        llvm::json::OStream J(os);
+        J.object([&] {
+            J.attribute("format", format);
+            J.attribute("failures", failures);
+            J.attributeArray("files", [&] {
+                for (const FileReport& file : files)
+                    J.object([&] {
+                        J.attribute("path", file.path);
+                        J.attribute("report", file.report);
+                        if (file.milliseconds >= 0)
+                            J.attribute("milliseconds", file.milliseconds);
+                    });
+            });
+            J.attributeArray("headerReports", [&] {
+                for (const auto& report : headerReports)
+                    J.object([&] {
+                        J.attribute("usr", report.first);
+                        J.attribute("report", report.second);
+                    });
+            });
+        });
+        os.flush();
+        return writeFileAtomic(path, content);
+    }
+
+    static llvm::Expected<ShardResult> read(llvm::StringRef path)
+    {
+        auto buffer = llvm::MemoryBuffer::getFile(path);
+        if (!buffer)
+            return llvm::errorCodeToError(buffer.getError());
+        llvm::Expected<llvm::json::Value> value = llvm::json::parse((*buffer)->getBuffer());
+        if (!value)
+            return value.takeError();
+
+        auto malformed = [&] {
+            return llvm::createStringError(llvm::inconvertibleErrorCode(), "malformed shard result");
+        };
+        const llvm::json::Object* root = value->getAsObject();
+        if (!root)
+            return malformed();
+        ShardResult result;
+        llvm::Optional<llvm::StringRef> format = root->getString("format");
+        llvm::Optional<int64_t> failures = root->getInteger("failures");
+        const llvm::json::Array* files = root->getArray("files");
+        const llvm::json::Array* headerReports = root->getArray("headerReports");
+        if (!format || !failures || !files || !headerReports)
+            return malformed();
+        result.format = format->str();
+        result.failures = *failures;
+        for (const llvm::json::Value& item : *files) {
+            const llvm::json::Object* file = item.getAsObject();
+            llvm::Optional<llvm::StringRef> filePath = file ? file->getString("path") : llvm::None;
+            llvm::Optional<llvm::StringRef> report = file ? file->getString("report") : llvm::None;
+            if (!filePath || !report)
+                return malformed();
+            result.files.push_back({filePath->str(), report->str(),
+                                    file->getNumber("milliseconds").getValueOr(-1)});
+        }
+        for (const llvm::json::Value& item : *headerReports) {
+            const llvm::json::Object* report = item.getAsObject();
+            llvm::Optional<llvm::StringRef> usr = report ? report->getString("usr") : llvm::None;
+            llvm::Optional<llvm::StringRef> text = report ? report->getString("report") : llvm::None;
+            if (!usr || !text)
+                return malformed();
+            result.headerReports.emplace_back(usr->str(), text->str());
+        }
+        return result;
+    }
+};
+
+} // namespace SingletonChecker
+
+#endif // SINGLETON_CHECKER_SHARDING_H
@@ -0,0 +1,2542 @@
+#ifndef SINGLETON_CHECKER_H
+#define SINGLETON_CHECKER_H
+
+#include "clang/Frontend/FrontendAction.h"
+#include "clang/AST/AST.h"
+#include "clang/AST/ASTConsumer.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Analysis/AnalysisDeclContext.h"
+#include "clang/Analysis/Analyses/Dominators.h"
+#include "clang/Analysis/CFG.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Index/USRGeneration.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Optional.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/ADT/StringSwitch.h"
+#include "llvm/Pass.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SaveAndRestore.h"
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/Timer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <algorithm>
+#include <iterator>
+#include <limits>
+
+#include "AnalyzedRegistry.h"
+#include "AnalysisData.h"
+#include "DetectionIndex.h"
+#include "InstanceSummary.h"
+#include "MatcherEngine.h"
+#include "ReportWriter.h"
+
+using namespace clang;
+
+// Printed by clang -print-stats; the build defines LLVM_FORCE_ENABLE_STATS
+// so they are counted with a release LLVM as well.
+#define DEBUG_TYPE "singleton-checker"
+STATISTIC(NumSubtreesPruned,         "Out of scope declarations not traversed");
+STATISTIC(NumClassesVisited,         "Classes visited");
+STATISTIC(NumClassesSkipped,         "Classes skipped (not a free standing definition)");
+STATISTIC(NumClassesAlreadyAnalysed, "Header classes already analysed by another TU");
+STATISTIC(NumClassesPrunedByKind,    "Classes pruned by the kind prefilter (lambdas)");
+STATISTIC(NumClassesPrunedByCtors,   "Classes pruned by the constructor stage");
+STATISTIC(NumClassesPrunedByCandidates, "Classes pruned with no getInstance candidate or friend");
+STATISTIC(NumClassesBodyAnalysed,    "Classes reaching body analysis");
+STATISTIC(NumClassesPrunedByMethods, "Classes pruned by the method stage");
+STATISTIC(NumClassesPrunedByFields,  "Classes pruned by the static field stage");
+STATISTIC(NumClassesPrunedByFriends, "Classes pruned by the friend stage");
+STATISTIC(NumClassesReported,        "Classes reported");
+STATISTIC(NumFunctionsVisited,       "Free functions visited");
+STATISTIC(NumFunctionsReported,      "Free functions reported");
+STATISTIC(NumBodiesScanned,          "Function bodies scanned");
+STATISTIC(NumStmtsWalked,            "Statements walked in function bodies");
+STATISTIC(NumCFGsBuilt,              "CFGs built for getInstance candidates");
+STATISTIC(NumLoopCallsSeen,          "Calls repeated by a loop");
+STATISTIC(NumHotCallsReported,       "getInstance calls inside loops reported");
+STATISTIC(NumStartupInitsReported,   "Singleton instances initialized before main reported");
+
+
+namespace AnalysisAlgorithm 
+{
+        template<typename T>
+        bool isClassObject(T* varDecl, CXXRecordDecl* clssDecl)
+        {
+            if (!(varDecl && clssDecl)) return false;
+            return !varDecl->getType()->isPointerType() && !varDecl->getType()->isReferenceType()
+                && (varDecl->getType()->getCanonicalTypeUnqualified() == clssDecl->getTypeForDecl()->getCanonicalTypeUnqualified());
+        }
+
+        template<typename T>
+        struct function_traits;
+
+        template<typename Ret, typename Class, typename Arg>
+        struct function_traits<Ret(Class::*)(Arg) const> {
+            using arg_type = Arg;
+        };
+
+        template<typename Callable>
+        struct function_traits : function_traits<decltype(&Callable::operator())> {};
+
+        template<typename InputIt, typename UnaryPred>
+        typename std::iterator_traits<InputIt>::difference_type
+        count_if(InputIt first, InputIt last, UnaryPred p)
+        {
+            using Cast = std::remove_pointer_t<typename function_traits<UnaryPred>::arg_type>;
+            typename std::iterator_traits<InputIt>::difference_type ret = 0;
+            for (; first != last; ++first) {
+                if (auto *c = dyn_cast<Cast>(*first))
+                    if (p(c))
+                        ++ret;
+            }
+            return ret;
+        }
+
+        inline int countClassStaticObject(CXXRecordDecl* clssDecl, FunctionDecl* funcDecl)
+        {
+            if (!funcDecl->hasBody() || !(clssDecl && funcDecl)) return 0;
+            
+            int count = 0;
+            for (Stmt* st : funcDecl->getBody()->children()) {
+                if (auto *declStmt = dyn_cast<DeclStmt>(st)) {
+                    count += count_if(declStmt->decl_begin(), declStmt->decl_end(), 
+                        [&](VarDecl* var) {
+                            return isClassObject(var, clssDecl) && var->isStaticLocal();
+                        }
+                    );
+                }
+            }
+            return count;
+        }
+
+        inline int countClassStaticObject(CXXRecordDecl* clssDecl, CXXRecordDecl* targetClssDecl)
+        {
+            if (!(clssDecl && targetClssDecl)) return 0;
+            
+            int count = 0;
+            for (auto* field : targetClssDecl->decls()) 
+                if (isClassObject(dyn_cast<VarDecl>(field), clssDecl))
+                   ++count;
+            
+            for (auto* method : targetClssDecl->methods()) 
+                count += countClassStaticObject(clssDecl, method);
+            
+            return count; 
+        }
+
+        inline bool findClassLocalObject(CXXRecordDecl* clssDecl, CXXRecordDecl* targetClssDecl)
+        {
+            if (!(clssDecl && targetClssDecl)) return 0;
+           
+            for (auto* field : targetClssDecl->fields()) {
+                if (field->getType()->isPointerType() || field->getType()->isReferenceType())
+                   continue;
+                else if (isClassObject(field, clssDecl))
+                    return true;
+            }
+            return false;
+        }
+
+        inline bool findClassLocalObject(CXXRecordDecl* clssDecl, FunctionDecl* funcDecl)
+        {
+            if (!funcDecl->hasBody() || !(clssDecl && funcDecl)) return false;
+            
+            for (Stmt* st : funcDecl->getBody()->children()) {
+                if (auto *declStmt = dyn_cast<DeclStmt>(st)) {
+                    for (Decl* dcl : declStmt->decls()) {
+                        if (VarDecl* varDecl = dyn_cast<VarDecl>(dcl)){
+                            if (isClassObject(varDecl, clssDecl) && !varDecl->isStaticLocal()) {
+                               return true;
+                            }
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+        inline bool isSameType(QualType type1, QualType type2) {
+          return type1.getTypePtr()->getUnqualifiedDesugaredType() == 
+                 type2.getTypePtr()->getUnqualifiedDesugaredType();
+        }
+
+        inline bool compareReturnTypeWithRecordType(FunctionDecl *method, CXXRecordDecl *record) {
+            if (!method || !record) return false;
+            
+            QualType returnType = method->getReturnType();
+            QualType recordType = record->getASTContext().getRecordType(record);
+            
+            if (returnType->isPointerType() || returnType->isReferenceType()) {
+                returnType = returnType->getPointeeType();
+            }
+
+            return isSameType(returnType.getUnqualifiedType(), 
+                             recordType.getUnqualifiedType());
+        }
+
+        template<typename Op1, typename Op2>
+        bool isEQNEBetween(BinaryOperator* bo) 
+        {
+           if (!bo) return false; 
+           if (bo->getOpcode() != BO_EQ && bo->getOpcode() != BO_NE)
+               return false;
+           return isa<Op1>(bo->getLHS()->IgnoreImpCasts()) && isa<Op2>(bo->getRHS()->IgnoreImpCasts());
+        }
+
+        // Name of the class (or class template) of namespace std the type
+        // refers to, e.g. "unique_ptr" for std::unique_ptr<T>&; empty otherwise.
+        inline StringRef stdRecordName(QualType type) {
+            if (type.isNull()) return "";
+            type = type.getNonReferenceType();
+            const NamedDecl* decl = type->getAsCXXRecordDecl();
+            if (!decl)
+                if (auto* spec = type->getAs<TemplateSpecializationType>())
+                    decl = spec->getTemplateName().getAsTemplateDecl();
+            if (!decl || !decl->getIdentifier() || !decl->isInStdNamespace()) return "";
+            return decl->getName();
+        }
+
+        inline bool isSmartPointer(QualType type) {
+            StringRef name = stdRecordName(type);
+            return name == "unique_ptr" || name == "shared_ptr";
+        }
+
+        // Type of the object a member is called on, through -> as well.
+        inline QualType objectType(CXXMemberCallExpr* call) {
+            Expr* object = call->getImplicitObjectArgument();
+            if (!object) return QualType();
+            QualType type = object->getType();
+            return type->isPointerType() ? type->getPointeeType() : type;
+        }
+
+        inline bool isMethodNamed(CXXMemberCallExpr* call, StringRef name) {
+            const CXXMethodDecl* method = call->getMethodDecl();
+            return method && method->getIdentifier() && method->getName() == name;
+        }
+
+        // var, or a var read through its std wrapper: *var, var->, var.get()
+        // and the conversion of a smart pointer, load() and the conversion
+        // of an atomic.
+        inline VarDecl* getVarDeclFromExpr(Expr* expr) {
+            expr = expr->IgnoreParenCasts();
+            if (auto* op = dyn_cast<CXXOperatorCallExpr>(expr)) {
+                if ((op->getOperator() == OO_Star || op->getOperator() == OO_Arrow)
+                    && op->getNumArgs() >= 1 && isSmartPointer(op->getArg(0)->getType()))
+                    expr = op->getArg(0)->IgnoreParenCasts();
+            }
+            else if (auto* call = dyn_cast<CXXMemberCallExpr>(expr)) {
+                QualType object = objectType(call);
+                bool conversion = isa_and_nonnull<CXXConversionDecl>(call->getMethodDecl());
+                if ((isSmartPointer(object) && (conversion || isMethodNamed(call, "get")))
+                    || (stdRecordName(object) == "atomic" && (conversion || isMethodNamed(call, "load"))))
+                    expr = call->getImplicitObjectArgument()->IgnoreParenCasts();
+            }
+            if (auto *declRef = dyn_cast<DeclRefExpr>(expr)) 
+                return dyn_cast<VarDecl>(declRef->getDecl());
+            return nullptr;
+        }
+
+        // First statement of the subtree satisfying pred in pre-order, found
+        // with an explicit stack instead of recursion. Every visited node 
+        // costs one unit of budget; when it runs out the search stops and
+        // sets exhausted.
+        inline Stmt* findStmt(Stmt* root, llvm::function_ref<bool(Stmt*)> pred,
+                              unsigned& budget, bool& exhausted)
+        {
+            llvm::SmallVector<Stmt*, 32> worklist;
+            if (root) worklist.push_back(root);
+            
+            while (!worklist.empty()) {
+                if (budget == 0) {
+                    exhausted = true;
+                    return nullptr;
+                }
+                --budget;
+                
+                Stmt* stmt = worklist.pop_back_val();
+                if (pred(stmt))
+                    return stmt;
+                
+                // Children are pushed reversed to be popped in source order.
+                size_t firstChild = worklist.size();
+                for (Stmt* child : stmt->children())
+                    if (child) worklist.push_back(child);
+                std::reverse(worklist.begin() + firstChild, worklist.end());
+            }
+            return nullptr;
+        }
+
+        // First assignment to var in pre-order.
+        inline BinaryOperator* findAssignmentToVar(Stmt* root, const VarDecl* var, 
+                                                   unsigned& budget, bool& exhausted)
+        {
+            return cast_or_null<BinaryOperator>(findStmt(root, [&](Stmt* stmt) {
+                auto* binOp = dyn_cast<BinaryOperator>(stmt);
+                return binOp && binOp->getOpcode() == BO_Assign 
+                    && getVarDeclFromExpr(binOp->getLHS()) == var;
+            }, budget, exhausted));
+        }
+
+        // std::lock_guard / unique_lock / scoped_lock declared, a std mutex 
+        // locked, or pthread_mutex_lock called.
+        inline bool isLockStmt(Stmt* stmt) {
+            if (auto* declStmt = dyn_cast<DeclStmt>(stmt)) {
+                for (Decl* decl : declStmt->decls()) {
+                    auto* var = dyn_cast<VarDecl>(decl);
+                    if (!var) continue;
+                    StringRef name = stdRecordName(var->getType());
+                    if (name == "lock_guard" || name == "unique_lock" || name == "scoped_lock")
+                        return true;
+                }
+                return false;
+            }
+            if (auto* call = dyn_cast<CXXMemberCallExpr>(stmt))
+                return isMethodNamed(call, "lock") && stdRecordName(objectType(call)).endswith("mutex");
+            if (auto* call = dyn_cast<CallExpr>(stmt)) {
+                const FunctionDecl* callee = call->getDirectCallee();
+                return callee && callee->getIdentifier() && callee->getName() == "pthread_mutex_lock";
+            }
+            return false;
+        }
+
+        inline bool isCallOnce(Stmt* stmt) {
+            auto* call = dyn_cast<CallExpr>(stmt);
+            const FunctionDecl* callee = call ? call->getDirectCallee() : nullptr;
+            if (!callee || !callee->getIdentifier()) return false;
+            return (callee->getName() == "call_once" && callee->isInStdNamespace())
+                || callee->getName() == "pthread_once";
+        }
+
+        // Load of a std::atomic, explicit or through its conversion; relaxed
+        // tells a memory_order_relaxed load.
+        inline bool isAtomicLoad(Stmt* stmt, bool& relaxed) {
+            auto* call = dyn_cast<CXXMemberCallExpr>(stmt);
+            if (!call || stdRecordName(objectType(call)) != "atomic") 
+                return false;
+            if (!isa_and_nonnull<CXXConversionDecl>(call->getMethodDecl()) && !isMethodNamed(call, "load"))
+                return false;
+            relaxed = false;
+            if (call->getNumArgs() > 0)
+                if (auto* order = dyn_cast<DeclRefExpr>(call->getArg(0)->IgnoreParenImpCasts()))
+                    relaxed = StringRef(order->getDecl()->getNameAsString()).endswith("relaxed");
+            return true;
+        }
+
+        // Whether a function-local static is initialized under a guard: a 
+        // dynamic initializer or a destructor to register.
+        inline bool needsStaticGuard(const VarDecl* var) {
+            if (var->getType().isDestructedType()) return true;
+            const Expr* init = var->getInit();
+            if (!init) return false;
+            if (init->isValueDependent()) return true;
+            return !init->isConstantInitializer(var->getASTContext(), var->getType()->isReferenceType());
+        }
+
+        inline VarDecl* extractVarFromUnary(Expr* expr) {
+            if (auto* unop = dyn_cast<UnaryOperator>(expr->IgnoreImpCasts())) {
+                if (unop->getOpcode() == UO_AddrOf || unop->getOpcode() == UO_Deref) {
+                    return getVarDeclFromExpr(unop->getSubExpr()->IgnoreParenCasts());
+                }
+            }
+            return getVarDeclFromExpr(expr->IgnoreImpCasts());
+        };
+};
+
+
+namespace SingletonChecker {
+
+struct CheckerOptions {
+    enum AnalysisScope {
+        MainFileOnly,       // declarations of the main file
+        ProjectHeaders,     // main file and non-system headers (under projectRoot if set)
+        Everything,         // system headers included
+    } scope = MainFileOnly;
+
+    std::string projectRoot;
+    // Shared "already analysed" registry of header declarations, and the
+    // build run its claims belong to.
+    std::string registryDir;
+    std::string registryRun;
+    // Per-TU summaries of static objects for the whole-program count.
+    std::string instanceSummaryDir;
+    // Directory of the per-TU detection indexes read by singleton-query.
+    std::string detectionIndexDir;
+
+    OutputFormat format = OutputFormat::Text;
+    AnalysisEngine engine = AnalysisEngine::Visitor;
+
+    // Statements one function body may cost before its analysis is given
+    // up and reported as skipped, 0 = unlimited.
+    unsigned nodeBudget = 0;
+
+    // Report the static singleton instances initialized before main.
+    bool startupAudit = false;
+
+    bool printCacheStats = false;
+    bool printPrefilterStats = false;
+
+    // Everything that changes the report or the side outputs a cache entry
+    // replays, part of the result cache key.
+    std::string fingerprint() const
+    {
+        return std::to_string(scope) + ";" + projectRoot + ";" + std::to_string(int(format))
+             + ";" + std::to_string(nodeBudget) + ";" + std::to_string(int(engine))
+             + ";" + std::to_string(startupAudit) + ";" + std::to_string(!instanceSummaryDir.empty())
+             + ";" + std::to_string(!detectionIndexDir.empty());
+    }
+
+    // Stored absolute, without dots or symlinks, as the paths of the files
+    // ScopeFilter compares with it.
+    void setProjectRoot(StringRef root)
+    {
+        projectRoot.clear();
+        if (root.empty()) return;
+        llvm::SmallString<256> path;
+        if (llvm::sys::fs::real_path(root, path)) {
+            path = root;
+            llvm::sys::fs::make_absolute(path);
+            llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+        }
+        projectRoot = std::string(path.str());
+    }
+
+    static llvm::Optional<AnalysisScope> parseScope(StringRef value)
+    {
+        return llvm::StringSwitch<llvm::Optional<AnalysisScope>>(value)
+            .Case("main", MainFileOnly)
+            .Case("project", ProjectHeaders)
+            .Case("all", Everything)
+            .Default(llvm::None);
+    }
+};
+
+// Side results of one TU for the standalone driver.
+struct TranslationUnitInfo {
+    // Absolute paths of every file read by the TU, main file included.
+    std::vector<std::string> dependencies;
+    // Reports of header declarations claimed by this TU, by USR.
+    std::vector<std::pair<std::string, std::string>> headerReports;
+    // USRs of the header declarations the TU reports on, whichever TU
+    // claims them, and of those it claimed; the result cache keeps the
+    // reports of the claimed ones (empty or not) apart from the TU entry.
+    std::vector<std::string> headerUSRs;
+    std::vector<std::string> claimedHeaderUSRs;
+    // Main file name of the side outputs and their content, empty if not
+    // requested; the driver replays them for TUs found in its cache.
+    std::string mainFile;
+    std::string instanceSummary;
+    std::string detectionIndex;
+};
+
+// Name the per-TU side outputs are keyed by, empty without a main file.
+inline std::string mainFileName(const SourceManager& SM)
+{
+    const FileEntry* mainFile = SM.getFileEntryForID(SM.getMainFileID());
+    if (!mainFile) return "";
+    StringRef name = mainFile->tryGetRealPathName();
+    return (name.empty() ? mainFile->getName() : name).str();
+}
+
+// Decides which declarations are analysed at all. Used by the traversal 
+// to skip whole subtrees (namespaces, records) of out of scope files.
+class ScopeFilter 
+{
+    const SourceManager& SM;
+    const CheckerOptions& Opts;
+    llvm::DenseMap<FileID, bool> fileInProject;
+
+    bool isProjectFile(SourceLocation expansionLoc)
+    {
+        if (Opts.projectRoot.empty()) return true;
+        
+        FileID fid = SM.getFileID(expansionLoc);
+        auto it = fileInProject.find(fid);
+        if (it != fileInProject.end()) return it->second;
+        
+        // Names are spelled as the files were found, e.g. relative to an
+        // -I directory; compared by real path, on a separator boundary.
+        bool inProject = false;
+        if (const FileEntry* fe = SM.getFileEntryForID(fid)) {
+            llvm::SmallString<256> path(fe->tryGetRealPathName());
+            if (path.empty()) {
+                path = fe->getName();
+                SM.getFileManager().makeAbsolutePath(path);
+                llvm::sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+            }
+            inProject = isUnder(path, Opts.projectRoot);
+        }
+        return fileInProject[fid] = inProject;
+    }
+
+    // dir itself or below it: /src/app does not contain /src/app2.
+    static bool isUnder(StringRef path, StringRef dir)
+    {
+        if (!path.consume_front(dir))
+            return false;
+        return path.empty() || llvm::sys::path::is_separator(dir.back())
+            || llvm::sys::path::is_separator(path.front());
+    }
+
+public:
+    ScopeFilter(const SourceManager& SM, const CheckerOptions& Opts) : SM(SM), Opts(Opts) {}
+
+    bool isOutOfScope(const Decl* decl)
+    {
+        if (!decl) return true;
+        if (Opts.scope == CheckerOptions::Everything) return false;
+
+        SourceLocation loc = decl->getLocation();
+        if (loc.isInvalid()) return true;
+
+        if (SM.isInSystemHeader(loc) || SM.isInSystemMacro(loc))
+            return true;
+
+        if (SM.isInMainFile(loc) || SM.isWrittenInMainFile(loc))
+            return false;
+
+        return Opts.scope == CheckerOptions::MainFileOnly 
+            || !isProjectFile(SM.getExpansionLoc(loc));
+    }
+};
+
+// Declarations of headers are seen by every TU that includes them. They 
+// are identified by USR and analysed only by the TU that claims them first
+// in the registry. The driver receives their reports apart from the main 
+// file ones, so the merged output does not depend on which TU it was.
+class HeaderDeclTracker
+{
+    const SourceManager& SM;
+    llvm::raw_ostream& OS;
+    AnalyzedRegistry* registry;
+    TranslationUnitInfo* info;
+
+public:
+    HeaderDeclTracker(const SourceManager& SM, llvm::raw_ostream& OS, 
+                      AnalyzedRegistry* registry, TranslationUnitInfo* info)
+        : SM(SM), OS(OS), registry(registry), info(info) {}
+
+    // False if another TU already analysed the declaration. 
+    // usr is left empty for main file declarations. A tag tells apart 
+    // reports about the same declaration (e.g. the calls made by a function).
+    bool claim(const Decl* decl, std::string& usr, StringRef tag = "")
+    {
+        usr.clear();
+        SourceLocation loc = decl->getLocation();
+        if (SM.isInMainFile(loc) || SM.isWrittenInMainFile(loc))
+            return true;
+
+        llvm::SmallString<128> buf;
+        if (index::generateUSRForDecl(decl, buf))
+            return true;
+        usr = std::string(buf.str()) + tag.str();
+        bool claimed = !registry || registry->claim(usr);
+        if (info) {
+            info->headerUSRs.push_back(usr);
+            if (claimed)
+                info->claimedHeaderUSRs.push_back(usr);
+        }
+        return claimed;
+    }
+
+    template<typename Print>
+    void report(StringRef usr, Print print)
+    {
+        if (usr.empty() || !info) {
+            print(OS);
+            return;
+        }
+        std::string text;
+        llvm::raw_string_ostream os(text);
+        print(os);
+        info->headerReports.emplace_back(usr.str(), std::move(os.str()));
+    }
+};
+
+// CFGs of the getInstance candidates of one TU for the cfg engine, built
+// on first use through one AnalysisDeclContextManager, so the detectors
+// asking for the same function (returns, ifs, access cost, creation 
+// methods) share them. Only candidates passing the signature check get
+// one (free functions, friends, static methods of the classes the 
+// prefilter kept), and the other static methods assigning the instance of
+// a class whose getInstance does not create it. Not thread safe: the construction evaluates 
+// constant conditions through the ASTContext.
+class FunctionCFGs
+{
+public:
+    struct Body {
+        CFG* cfg;
+        mutable CFGDomTree dominators;
+
+        bool isReachable(const CFGBlock* block) const
+        {
+            return block && dominators.getBase().isReachableFromEntry(block);
+        }
+
+        // Runs on every call that returns.
+        bool isOnEveryPath(const CFGBlock* block) const
+        {
+            return isReachable(block) && isReachable(&cfg->getExit())
+                && dominators.dominates(block, &cfg->getExit());
+        }
+    };
+
+private:
+    AnalysisDeclContextManager manager;
+    llvm::DenseMap<const FunctionDecl*, std::unique_ptr<Body>> bodies;
+
+public:
+    explicit FunctionCFGs(ASTContext& context) : manager(context)
+    {
+        // Every statement is an element of its block: the detectors look at
+        // the elements instead of walking subtrees again.
+        manager.getCFGBuildOptions().setAllAlwaysAdd();
+    }
+
+    // Null if the CFG cannot be built, dependent bodies are not tried.
+    const Body* bodyOf(const FunctionDecl* func)
+    {
+        auto inserted = bodies.try_emplace(func);
+        if (!inserted.second || func->isDependentContext() || !func->hasBody())
+            return inserted.first->second.get();
+
+        llvm::TimeTraceScope timeScope("SingletonCFGBuild", [&] { return func->getNameAsString(); });
+        CFG* cfg = manager.getContext(func)->getCFG();
+        if (!cfg)
+            return nullptr;
+        ++NumCFGsBuilt;
+        std::unique_ptr<Body>& body = inserted.first->second;
+        body = std::make_unique<Body>();
+        body->cfg = cfg;
+        body->dominators.buildDominatorTree(cfg);
+        return body.get();
+    }
+};
+
+class GetInstancePatternAnalyser
+{
+    AnalysisData& analysisData;
+    // Statements one function may cost, 0 = unlimited.
+    unsigned nodeBudget;
+    unsigned remainingBudget = 0;
+    // Findings of the matcher engine, used instead of walking the body.
+    const PatternMatchEngine* matches;
+    // CFGs of the cfg engine, walked instead of the top level of the body.
+    FunctionCFGs* cfgs;
+
+    template<typename T1, typename T2>
+    struct AnalysisPair 
+    {
+        T1 extracted;
+        T2 param;
+    };
+
+    AnalysisPair<VarDecl*, AnalysisData::ConditionPatternInGetInstance> analysisCondition(Expr* ce)
+    {
+        using AnalysisAlgorithm::getVarDeclFromExpr;
+        if (!ce) return {nullptr, AnalysisData::UnknownCondition};
+        
+        Expr* clearCE = ce->IgnoreParenImpCasts();
+        
+        // instance
+        if (VarDecl* var = getVarDeclFromExpr(clearCE))
+            return {var, AnalysisData::VarInCondition};
+        
+        //  !instance
+        else if (auto* unOp = dyn_cast<UnaryOperator>(clearCE)) {
+            if (unOp->getOpcode() == UO_LNot) {
+                Expr* subExpr = unOp->getSubExpr()->IgnoreParenImpCasts();
+                    return {getVarDeclFromExpr(subExpr), AnalysisData::UnaryOperatorInCondition};
+            }
+        }
+        
+        // (instance == nullptr, nullptr == instance и т.д.)
+        else if (auto* binOp = dyn_cast<BinaryOperator>(clearCE)) {
+            if (binOp->getOpcode() == BO_EQ || binOp->getOpcode() == BO_NE) {
+                Expr* lhs = binOp->getLHS()->IgnoreParenImpCasts();
+                Expr* rhs = binOp->getRHS()->IgnoreParenImpCasts();
+                
+                auto checkNullComparison = [&](Expr* varSide, Expr* nullSide) -> VarDecl* {
+                    if (VarDecl* var = getVarDeclFromExpr(varSide))
+                        if (isa<CXXNullPtrLiteralExpr>(nullSide) 
+                        ||  isa<GNUNullExpr>(nullSide)) 
+                                return var;
+                    return nullptr;
+                };
+                
+                if (VarDecl* var = checkNullComparison(lhs, rhs)) {
+                    return {var, AnalysisData::BinaryOperatorInConditionNullptr};
+                }
+                if (VarDecl* var = checkNullComparison(rhs, lhs)) {
+                    return {var, AnalysisData::BinaryOperatorInConditionNullptr};
+                }
+            }
+        }
+        
+        //  (instance ? ... : ...)
+        else if (auto* condOp = dyn_cast<ConditionalOperator>(clearCE)) 
+            return analysisCondition(condOp->getCond());
+        
+        return {nullptr, AnalysisData::UnknownCondition};
+    }
+
+    VarDecl* analyzeReturnExpression(Expr* retExpr) {
+        using AnalysisAlgorithm::getVarDeclFromExpr;
+        using AnalysisAlgorithm::extractVarFromUnary;
+
+        if (!retExpr) return nullptr;
+        
+        retExpr = retExpr->IgnoreParenImpCasts();
+       
+        // Handle unary operators (& and *) or just var
+        VarDecl* returnedVar = extractVarFromUnary(retExpr);
+        
+        // Handle conditional operator (?:)
+        if (auto* condOp = dyn_cast<ConditionalOperator>(retExpr)) {
+            returnedVar = analyzeConditionalOperator(condOp);
+        }
+        
+        return returnedVar;
+    }
+    
+    VarDecl* analyzeConditionalOperator(ConditionalOperator* condOp) {
+        using AnalysisAlgorithm::getVarDeclFromExpr;
+        using AnalysisAlgorithm::extractVarFromUnary;
+
+        auto conditionResult = analysisCondition(condOp->getCond());
+        VarDecl* conditionVar = conditionResult.extracted;
+        
+        if (!conditionVar) {
+            analysisData.unknownPatternSingletone = true;
+            return nullptr;
+        }
+        analysisData.conditionPatternInGetInstance = conditionResult.param;
+
+        VarDecl* returnedVar = extractVarFromUnary(condOp->getTrueExpr()) ? : extractVarFromUnary(condOp->getFalseExpr());
+        
+        if (returnedVar != conditionVar) {
+            if (conditionVar->getType()->isBooleanType()) {
+                analysisData.probablyFlagsNaiveSingletone = true;
+            } else {
+                analysisData.unknownPatternSingletone = true;
+            }
+        }
+        
+        return returnedVar;
+    }
+    
+    // The var the statement returns, if any.
+    VarDecl* analyzeReturnStatement(ReturnStmt* retStmt) {
+        using AnalysisAlgorithm::getVarDeclFromExpr;
+        
+        Expr* retExpr = retStmt->getRetValue();
+        if (!retExpr) return nullptr;
+        
+        VarDecl* returnedVar = analyzeReturnExpression(retExpr);
+        
+        if (returnedVar) {
+            analysisData.instanceField = returnedVar;
+            // Mayer's pattern
+            if (returnedVar->isStaticLocal()) {
+                analysisData.probablyMayersSingletone = true;
+            }
+            // Naive pattern
+            else if (returnedVar->isStaticDataMember() && 
+                    returnedVar->getAccess() != AS_public) {
+                analysisData.probabalyNaiveSingletone = true;
+            }
+        }
+        return returnedVar;
+    }
+    
+    void analyzeIfStatement(IfStmt* ifStmt) {
+        using AnalysisAlgorithm::findAssignmentToVar;
+        
+        Expr* condition = ifStmt->getCond();
+        if (!condition) return;
+        
+        auto conditionResult = analysisCondition(condition);
+        VarDecl* conditionVar = conditionResult.extracted;
+        
+        if (!conditionVar) return;
+        analysisData.conditionPatternInGetInstance = conditionResult.param;
+        
+        Stmt* thenBody = ifStmt->getThen();
+        if (!thenBody) return;
+       
+        analysisData.probablyFlagsNaiveSingletone = conditionVar->getType()->isBooleanType();
+
+        if (!conditionVar->isStaticDataMember() || conditionVar->getAccess() != AS_private)
+            return;
+
+        bool exhausted = false;
+        unsigned budgetBefore = remainingBudget;
+        BinaryOperator* assign = findAssignmentToVar(thenBody, conditionVar, remainingBudget, exhausted);
+        NumStmtsWalked += budgetBefore - remainingBudget;
+        if (exhausted) {
+            analysisData.skippedByBudget = true;
+            return;
+        }
+        if (assign) {
+            analysisData.instanceField = conditionVar;
+            analysisData.probablyIfNaiveSingletone = true;
+            analysisData.assignmentInIfSinglton = assign;
+        }
+    }
+
+    struct AccessPaths {
+        bool lockEveryCall = false;
+        bool callOnce = false;
+        bool doubleChecked = false;
+        bool atomicLoad = false;
+        bool atomicAcquire = false;
+    };
+
+    // A lock or call_once at the top level of the body runs on every call;
+    // a lock under an if with a check inside is double-checked locking.
+    void findAccessPaths(FunctionDecl* method, AccessPaths& paths, unsigned& budget, bool& exhausted) {
+        using namespace AnalysisAlgorithm;
+
+        auto findAtomicLoads = [&](Stmt* root) {
+            findStmt(root, [&](Stmt* stmt) {
+                bool relaxed = false;
+                if (isAtomicLoad(stmt, relaxed)) {
+                    paths.atomicLoad = true;
+                    paths.atomicAcquire |= !relaxed;
+                }
+                return false;
+            }, budget, exhausted);
+        };
+
+        for (Stmt* stmt : method->getBody()->children()) {
+            if (!stmt) continue;
+            if (auto* ifStmt = dyn_cast<IfStmt>(stmt)) {
+                findAtomicLoads(ifStmt->getCond());
+                Stmt* slowPath = ifStmt->getThen();
+                paths.doubleChecked |= findStmt(slowPath, isLockStmt, budget, exhausted)
+                                    && findStmt(slowPath, [](Stmt* s) { return isa<IfStmt>(s); }, budget, exhausted);
+                continue;
+            }
+            paths.lockEveryCall |= findStmt(stmt, isLockStmt, budget, exhausted) != nullptr;
+            paths.callOnce |= findStmt(stmt, isCallOnce, budget, exhausted) != nullptr;
+            findAtomicLoads(stmt);
+        }
+    }
+
+    // Same paths on the CFG: what runs on every call is in a block on every
+    // path to the exit, wherever it is nested, and a lock off those paths
+    // guarding another check is double-checked locking.
+    void findAccessPaths(const FunctionCFGs::Body& body, AccessPaths& paths, unsigned& budget, bool& exhausted) {
+        using namespace AnalysisAlgorithm;
+
+        for (const CFGBlock* block : *body.cfg) {
+            if (!body.isReachable(block)) continue;
+            bool everyCall = body.isOnEveryPath(block);
+            for (const CFGElement& element : *block) {
+                Optional<CFGStmt> cfgStmt = element.getAs<CFGStmt>();
+                if (!cfgStmt) continue;
+                if (budget == 0) {
+                    exhausted = true;
+                    return;
+                }
+                --budget;
+
+                Stmt* stmt = const_cast<Stmt*>(cfgStmt->getStmt());
+                bool relaxed = false;
+                if (everyCall) {
+                    paths.lockEveryCall |= isLockStmt(stmt);
+                    paths.callOnce |= isCallOnce(stmt);
+                    if (isAtomicLoad(stmt, relaxed)) {
+                        paths.atomicLoad = true;
+                        paths.atomicAcquire |= !relaxed;
+                    }
+                }
+                else if (!paths.doubleChecked && isLockStmt(stmt)) {
+                    paths.doubleChecked = llvm::any_of(*body.cfg, [&](const CFGBlock* check) {
+                        return check && isa_and_nonnull<IfStmt>(check->getTerminatorStmt())
+                            && body.isReachable(check) && body.dominators.dominates(block, check);
+                    });
+                }
+            }
+        }
+    }
+
+    // Cost of the fast path of a detected getInstance: that of a lock, a
+    // call_once or a double-checked lock on it, otherwise that of reading
+    // the instance. Gives up (UnknownCost) with the budget.
+    void classifyAccessCost(FunctionDecl* method) {
+        using namespace AnalysisAlgorithm;
+        llvm::TimeTraceScope timeScope("SingletonAccessCost");
+
+        VarDecl* instance = analysisData.instanceField;
+        analysisData.smartPointerInstance = instance && isSmartPointer(instance->getType());
+
+        unsigned budget = nodeBudget ? nodeBudget : std::numeric_limits<unsigned>::max();
+        unsigned budgetBefore = budget;
+        bool exhausted = false;
+        AccessPaths paths;
+        const FunctionCFGs::Body* body = cfgs ? cfgs->bodyOf(method) : nullptr;
+        if (body)
+            findAccessPaths(*body, paths, budget, exhausted);
+        else
+            findAccessPaths(method, paths, budget, exhausted);
+        NumStmtsWalked += budgetBefore - budget;
+        if (exhausted)
+            return;
+
+        using Cost = AnalysisData::AccessCost;
+        Cost cost = AnalysisData::UnknownCost;
+        if (paths.lockEveryCall)
+            cost = AnalysisData::MutexEveryCall;
+        else if (paths.callOnce)
+            cost = AnalysisData::CallOnce;
+        else if (paths.doubleChecked)
+            cost = AnalysisData::DoubleCheckedLocking;
+        else if (paths.atomicAcquire)
+            cost = AnalysisData::AtomicAcquire;
+        else if (instance && instance->isStaticLocal())
+            cost = needsStaticGuard(instance) ? AnalysisData::StaticGuard : AnalysisData::PlainLoad;
+        else if (paths.atomicLoad || analysisData.probabalyNaiveSingletone || analysisData.probablyIfNaiveSingletone)
+            cost = AnalysisData::PlainLoad;
+        analysisData.accessCost = std::max<Cost>(analysisData.accessCost, cost);
+    }
+
+    // Whether the then branch of a check of var runs when var is null (or
+    // false): !instance and instance == nullptr, not instance or !=.
+    static bool nullOnTrueBranch(Expr* condition) {
+        Expr* clearCE = condition->IgnoreParenImpCasts();
+        if (auto* binOp = dyn_cast<BinaryOperator>(clearCE))
+            return binOp->getOpcode() == BO_EQ;
+        return isa<UnaryOperator>(clearCE);
+    }
+
+    // Assignment to var on the branch of the check where var is null, in a
+    // block that branch dominates. A branch that is also the join point of
+    // the if does not guard anything.
+    BinaryOperator* findGuardedAssignment(const CFGBlock* check, IfStmt* ifStmt, const VarDecl* var,
+                                          const FunctionCFGs::Body& body) {
+        using AnalysisAlgorithm::getVarDeclFromExpr;
+
+        if (check->succ_size() != 2)
+            return nullptr;
+        const CFGBlock* branch = *(check->succ_begin() + (nullOnTrueBranch(ifStmt->getCond()) ? 0 : 1));
+        if (!body.isReachable(branch) || branch->pred_size() != 1)
+            return nullptr;
+
+        for (const CFGBlock* block : *body.cfg) {
+            if (!body.isReachable(block) || !body.dominators.dominates(branch, block)) continue;
+            for (const CFGElement& element : *block) {
+                Optional<CFGStmt> cfgStmt = element.getAs<CFGStmt>();
+                if (!cfgStmt) continue;
+                if (!consumeBudget())
+                    return nullptr;
+                ++NumStmtsWalked;
+                auto* binOp = dyn_cast<BinaryOperator>(const_cast<Stmt*>(cfgStmt->getStmt()));
+                if (binOp && binOp->getOpcode() == BO_Assign && getVarDeclFromExpr(binOp->getLHS()) == var)
+                    return binOp;
+            }
+        }
+        return nullptr;
+    }
+
+    // CFG counterpart of analyzeIfStatement, for an if at any depth.
+    void analyzeIfBlock(const CFGBlock* check, IfStmt* ifStmt, const FunctionCFGs::Body& body) {
+        auto conditionResult = analysisCondition(ifStmt->getCond());
+        VarDecl* conditionVar = conditionResult.extracted;
+        if (!conditionVar) return;
+        analysisData.conditionPatternInGetInstance = conditionResult.param;
+        analysisData.probablyFlagsNaiveSingletone = conditionVar->getType()->isBooleanType();
+
+        if (!conditionVar->isStaticDataMember() || conditionVar->getAccess() != AS_private)
+            return;
+        if (BinaryOperator* assign = findGuardedAssignment(check, ifStmt, conditionVar, body)) {
+            analysisData.instanceField = conditionVar;
+            analysisData.probablyIfNaiveSingletone = true;
+            analysisData.assignmentInIfSinglton = assign;
+        }
+    }
+
+    // A getInstance that only returns the instance may leave its creation
+    // to another static method of the class (managed.cpp: create()). The
+    // first guarded assignment of the instance found there makes it an
+    // If-Naive singleton.
+    void analyzeCreationMethods(FunctionDecl* method) {
+        auto* getInstance = dyn_cast<CXXMethodDecl>(method);
+        VarDecl* instance = analysisData.instanceField;
+        if (!getInstance || !instance || !analysisData.probabalyNaiveSingletone 
+            || analysisData.assignmentInIfSinglton)
+            return;
+
+        for (CXXMethodDecl* creation : getInstance->getParent()->methods()) {
+            if (creation == getInstance || !creation->isStatic() || !creation->hasBody())
+                continue;
+            // Only a method assigning the instance somewhere gets a CFG.
+            bool exhausted = false;
+            unsigned budgetBefore = remainingBudget;
+            bool assigns = AnalysisAlgorithm::findAssignmentToVar(creation->getBody(), instance,
+                                                                  remainingBudget, exhausted);
+            NumStmtsWalked += budgetBefore - remainingBudget;
+            if (exhausted) {
+                analysisData.skippedByBudget = true;
+                return;
+            }
+            if (!assigns)
+                continue;
+            const FunctionCFGs::Body* body = cfgs->bodyOf(creation);
+            if (!body) continue;
+            for (const CFGBlock* block : *body->cfg) {
+                auto* ifStmt = block ? dyn_cast_or_null<IfStmt>(const_cast<Stmt*>(block->getTerminatorStmt())) : nullptr;
+                if (!ifStmt || !body->isReachable(block)
+                    || analysisCondition(ifStmt->getCond()).extracted != instance)
+                    continue;
+                if (BinaryOperator* assign = findGuardedAssignment(block, ifStmt, instance, *body)) {
+                    analysisData.probablyIfNaiveSingletone = true;
+                    analysisData.assignmentInIfSinglton = assign;
+                    return;
+                }
+                if (analysisData.skippedByBudget)
+                    return;
+            }
+        }
+    }
+
+    // Returns and ifs of every reachable block, however deep they are 
+    // nested (under a lock, a block, another if); statements after an
+    // early return of every path are not looked at. The returns naming a
+    // var must all name the same one: otherwise the instance would depend
+    // on the order of the blocks, and the pattern is unknown.
+    bool isProbablyGetInstanceCFG(FunctionDecl* method, const FunctionCFGs::Body& body) {
+        VarDecl* returned = nullptr;
+        bool disagree = false;
+        for (const CFGBlock* block : *body.cfg) {
+            if (!body.isReachable(block)) continue;
+            for (const CFGElement& element : *block) {
+                Optional<CFGStmt> cfgStmt = element.getAs<CFGStmt>();
+                if (!cfgStmt) continue;
+                if (!consumeBudget())
+                    return false;
+                ++NumStmtsWalked;
+                if (auto* retStmt = dyn_cast<ReturnStmt>(const_cast<Stmt*>(cfgStmt->getStmt())))
+                    if (VarDecl* var = analyzeReturnStatement(retStmt)) {
+                        disagree |= returned && returned != var;
+                        returned = var;
+                    }
+            }
+            if (auto* ifStmt = dyn_cast_or_null<IfStmt>(const_cast<Stmt*>(block->getTerminatorStmt())))
+                analyzeIfBlock(block, ifStmt, body);
+            if (analysisData.skippedByBudget)
+                return false;
+        }
+        if (disagree) {
+            analysisData.instanceField = nullptr;
+            analysisData.probabalyNaiveSingletone = false;
+            analysisData.probablyMayersSingletone = false;
+            analysisData.unknownPatternSingletone = true;
+            return false;
+        }
+        analyzeCreationMethods(method);
+        if (analysisData.skippedByBudget)
+            return false;
+        return detected(method);
+    }
+
+    bool detected(FunctionDecl* method) {
+        if (!analysisData.probabalyNaiveSingletone && !analysisData.probablyMayersSingletone)
+            return false;
+        classifyAccessCost(method);
+        return true;
+    }
+
+    bool consumeBudget() {
+        if (remainingBudget == 0) {
+            analysisData.skippedByBudget = true;
+            return false;
+        }
+        --remainingBudget;
+        return true;
+    }
+
+public:
+    bool isValidSingletonMethodSignature(FunctionDecl *method) {
+        return method && method->hasBody() && 
+           (method->getReturnType()->isPointerType() || 
+            method->getReturnType()->isReferenceType());
+    }
+
+    bool isProbablyGetInstanceFunction(FunctionDecl *method) 
+    {  
+        if (!isValidSingletonMethodSignature(method))
+            return false;
+
+        if (matches) {
+            if (const AnalysisData* found = matches->findingsOf(method))
+                analysisData.mergeGetInstanceFindings(*found);
+            return detected(method);
+        }
+
+        llvm::TimeTraceScope timeScope("SingletonGetInstanceAnalysis", 
+                                       [&] { return method->getNameAsString(); });
+        ++NumBodiesScanned;
+        remainingBudget = nodeBudget ? nodeBudget : std::numeric_limits<unsigned>::max();
+        if (cfgs)
+            if (const FunctionCFGs::Body* body = cfgs->bodyOf(method))
+                return isProbablyGetInstanceCFG(method, *body);
+        for (Stmt* stmt : method->getBody()->children()) {
+            if (!stmt) continue;
+            if (!consumeBudget() || analysisData.skippedByBudget)
+                return false;
+            ++NumStmtsWalked;
+            
+            if (auto *retStmt = dyn_cast<ReturnStmt>(stmt)) {
+                analyzeReturnStatement(retStmt);
+            }
+            else if (auto* ifStmt = dyn_cast<IfStmt>(stmt)) {
+                analyzeIfStatement(ifStmt);
+            }
+        }
+        
+        if (analysisData.skippedByBudget)
+            return false;
+        return detected(method);
+    }
+
+    GetInstancePatternAnalyser( AnalysisData& andata, unsigned nodeBudget = 0,
+                                const PatternMatchEngine* matches = nullptr,
+                                FunctionCFGs* cfgs = nullptr ) 
+        : analysisData(andata), nodeBudget(nodeBudget), matches(matches), cfgs(cfgs) {}
+};
+
+// Per-TU memo of body scans. A function or a friend class referenced by 
+// many classes is scanned once: the summary keeps, for every record type, 
+// how many static and non-static instances the body declares, so the next
+// classes only look their own type up.
+class ScanCache
+{
+public:
+    struct InstanceCounts {
+        unsigned statics = 0;
+        bool local = false;
+    };
+
+    struct GetInstanceFindings {
+        bool analysed = false;      // signature allowed the body analysis
+        AnalysisData data;
+    };
+
+private:
+    using Summary = llvm::SmallDenseMap<const Type*, InstanceCounts, 4>;
+
+    llvm::DenseMap<const FunctionDecl*, Summary> functionSummaries;
+    llvm::DenseMap<const CXXRecordDecl*, Summary> recordSummaries;
+    // Summaries of class template patterns, shared by their implicit 
+    // specializations. None if a member type depends on the template 
+    // arguments otherwise than as a bare type parameter.
+    llvm::DenseMap<const CXXRecordDecl*, llvm::Optional<Summary>> patternSummaries;
+    llvm::DenseMap<const FunctionDecl*, std::unique_ptr<GetInstanceFindings>> getInstanceFindings;
+
+    AnalysisData scratch;
+    GetInstancePatternAnalyser analyser;
+
+    unsigned hits = 0;
+    unsigned misses = 0;
+
+    static const Type* typeKey(QualType type)
+    {
+        return type->getCanonicalTypeUnqualified().getTypePtr();
+    }
+
+    static bool isInstanceType(QualType type)
+    {
+        return !type->isPointerType() && !type->isReferenceType() 
+            && (type->isRecordType() || type->getAs<TemplateTypeParmType>());
+    }
+
+    // Types of a template pattern that a specialization may turn into the
+    // class itself without being a bare type parameter (T::Self, Box<T>&...).
+    static bool isOpaqueDependentType(QualType type)
+    {
+        return type->isDependentType() && !type->getAs<TemplateTypeParmType>()
+            && !type->isPointerType() && !type->isReferenceType();
+    }
+
+    // Same statements as AnalysisAlgorithm::countClassStaticObject and 
+    // findClassLocalObject: declarations at the top level of the body.
+    static Summary scan(const FunctionDecl* func)
+    {
+        Summary summary;
+        if (!func->hasBody()) return summary;
+
+        ++NumBodiesScanned;
+        for (Stmt* st : func->getBody()->children()) {
+            ++NumStmtsWalked;
+            auto *declStmt = dyn_cast_or_null<DeclStmt>(st);
+            if (!declStmt) continue;
+            for (Decl* dcl : declStmt->decls()) {
+                auto* var = dyn_cast<VarDecl>(dcl);
+                if (!var || !isInstanceType(var->getType())) continue;
+                InstanceCounts& counts = summary[typeKey(var->getType())];
+                if (var->isStaticLocal())
+                    ++counts.statics;
+                else
+                    counts.local = true;
+            }
+        }
+        return summary;
+    }
+
+    const Summary& summaryOf(const FunctionDecl* func)
+    {
+        auto it = functionSummaries.find(func);
+        if (it != functionSummaries.end()) {
+            ++hits;
+            return it->second;
+        }
+        ++misses;
+        return functionSummaries[func] = scan(func);
+    }
+
+    // Static data members and methods count as static instances, 
+    // non-pointer fields as local ones (see the AnalysisAlgorithm overloads
+    // taking a target class).
+    const Summary& summaryOf(const CXXRecordDecl* record)
+    {
+        auto it = recordSummaries.find(record);
+        if (it != recordSummaries.end()) {
+            ++hits;
+            return it->second;
+        }
+        ++misses;
+
+        Summary summary;
+        for (const Decl* dcl : record->decls())
+            if (auto* var = dyn_cast<VarDecl>(dcl))
+                if (isInstanceType(var->getType()))
+                    ++summary[typeKey(var->getType())].statics;
+
+        for (const FieldDecl* field : record->fields())
+            if (isInstanceType(field->getType()))
+                summary[typeKey(field->getType())].local = true;
+
+        for (const CXXMethodDecl* method : record->methods())
+            for (const auto& entry : summaryOf(method))
+                summary[entry.first].statics += entry.second.statics;
+
+        return recordSummaries[record] = std::move(summary);
+    }
+
+    // Primary template the specialization was instantiated from, so that 
+    // the parameters of its pattern are the ones of the specialization.
+    static const CXXRecordDecl* patternOf(const ClassTemplateSpecializationDecl* specialization)
+    {
+        if (!isTemplateInstantiation(specialization->getSpecializationKind()))
+            return nullptr;
+        if (!specialization->getSpecializedTemplateOrPartial().is<ClassTemplateDecl*>())
+            return nullptr;
+        return specialization->getSpecializedTemplate()->getTemplatedDecl()->getDefinition();
+    }
+
+    const llvm::Optional<Summary>& summaryOfPattern(const CXXRecordDecl* pattern)
+    {
+        auto it = patternSummaries.find(pattern);
+        if (it != patternSummaries.end()) {
+            ++hits;
+            return it->second;
+        }
+        ++misses;
+
+        bool opaque = false;
+        for (const Decl* dcl : pattern->decls())
+            if (auto* var = dyn_cast<VarDecl>(dcl))
+                opaque |= isOpaqueDependentType(var->getType());
+        for (const FieldDecl* field : pattern->fields())
+            opaque |= isOpaqueDependentType(field->getType());
+        for (const CXXMethodDecl* method : pattern->methods())
+            if (method->hasBody())
+                for (Stmt* st : method->getBody()->children())
+                    if (auto* declStmt = dyn_cast_or_null<DeclStmt>(st))
+                        for (Decl* dcl : declStmt->decls())
+                            if (auto* var = dyn_cast<VarDecl>(dcl))
+                                opaque |= isOpaqueDependentType(var->getType());
+        if (opaque)
+            return patternSummaries[pattern] = llvm::None;
+        return patternSummaries[pattern] = summaryOf(pattern);
+    }
+
+    static InstanceCounts lookup(const Summary& summary, const CXXRecordDecl* clssDecl)
+    {
+        auto it = summary.find(typeKey(QualType(clssDecl->getTypeForDecl(), 0)));
+        return it == summary.end() ? InstanceCounts() : it->second;
+    }
+
+    // Counts of the class in a specialization, read from the summary of its
+    // pattern: the non-dependent types plus every type parameter whose 
+    // argument is the class.
+    static InstanceCounts lookup(const Summary& summary, 
+                                 const ClassTemplateSpecializationDecl* specialization,
+                                 const CXXRecordDecl* clssDecl)
+    {
+        InstanceCounts counts = lookup(summary, clssDecl);
+        const TemplateParameterList* params = specialization->getSpecializedTemplate()->getTemplateParameters();
+        ArrayRef<TemplateArgument> args = specialization->getTemplateArgs().asArray();
+        const Type* self = typeKey(QualType(clssDecl->getTypeForDecl(), 0));
+        for (unsigned i = 0; i < args.size() && i < params->size(); ++i) {
+            auto* param = dyn_cast<TemplateTypeParmDecl>(params->getParam(i));
+            if (!param || param->isParameterPack() || args[i].getKind() != TemplateArgument::Type
+                || typeKey(args[i].getAsType()) != self)
+                continue;
+            auto it = summary.find(typeKey(QualType(param->getTypeForDecl(), 0)));
+            if (it == summary.end())
+                continue;
+            counts.statics += it->second.statics;
+            counts.local |= it->second.local;
+        }
+        return counts;
+    }
+
+public:
+    ScanCache(unsigned nodeBudget, const PatternMatchEngine* matches, FunctionCFGs* cfgs = nullptr) 
+        : analyser(scratch, nodeBudget, matches, cfgs) {}
+
+    InstanceCounts instancesIn(const FunctionDecl* func, const CXXRecordDecl* clssDecl)
+    {
+        return lookup(summaryOf(func), clssDecl);
+    }
+
+    // Implicit specializations share the summary of their template pattern,
+    // so a friend Singleton<Derived> does not walk its instantiated bodies.
+    InstanceCounts instancesIn(const CXXRecordDecl* record, const CXXRecordDecl* clssDecl)
+    {
+        if (auto* specialization = dyn_cast<ClassTemplateSpecializationDecl>(record))
+            if (const CXXRecordDecl* pattern = patternOf(specialization)) {
+                const llvm::Optional<Summary>& summary = summaryOfPattern(pattern);
+                if (summary)
+                    return lookup(*summary, specialization, clssDecl);
+            }
+        return lookup(summaryOf(record), clssDecl);
+    }
+
+    // Result of GetInstancePatternAnalyser for the function on its own.
+    const GetInstanceFindings& findingsOf(FunctionDecl* func)
+    {
+        std::unique_ptr<GetInstanceFindings>& findings = getInstanceFindings[func];
+        if (findings) {
+            ++hits;
+            return *findings;
+        }
+        ++misses;
+
+        findings = std::make_unique<GetInstanceFindings>();
+        scratch.clear();
+        findings->analysed = analyser.isValidSingletonMethodSignature(func);
+        if (findings->analysed)
+            analyser.isProbablyGetInstanceFunction(func);
+        findings->data = scratch;
+        return *findings;
+    }
+
+    unsigned getHits() const { return hits; }
+    unsigned getMisses() const { return misses; }
+};
+
+// Reported classes of the TU for the detection index. Locations are kept
+// as file and offset; files get an index entry on their first use.
+class DetectionCollector {
+private:
+    SourceManager& SM;
+    DetectionIndexBuilder index;
+    llvm::DenseMap<FileID, unsigned> files;
+
+    DetectionIndexBuilder::Location locationOf(const Decl* decl) {
+        if (!decl)
+            return {};
+        std::pair<FileID, unsigned> decomposed = SM.getDecomposedExpansionLoc(decl->getLocation());
+        const FileEntry* file = SM.getFileEntryForID(decomposed.first);
+        if (!file)
+            return {};
+        auto inserted = files.try_emplace(decomposed.first, 0);
+        if (inserted.second) {
+            StringRef path = file->tryGetRealPathName();
+            inserted.first->second = index.addFile(path.empty() ? file->getName() : path);
+        }
+        return {inserted.first->second, decomposed.second};
+    }
+
+public:
+    explicit DetectionCollector(SourceManager& SM) : SM(SM) {}
+
+    void add(const CXXRecordDecl* record, const AnalysisData& data) {
+        using namespace DetectionFormat;
+        DetectionIndexBuilder::Detection detection;
+        llvm::SmallString<128> usr;
+        if (!index::generateUSRForDecl(record, usr))
+            detection.usr = usr.str().str();
+        detection.name = record->getQualifiedNameAsString();
+        detection.patterns = (data.probabalyNaiveSingletone ? Naive : 0)
+                           | (data.probablyMayersSingletone ? Meyers : 0)
+                           | (data.probabalyCRTPSingletone ? CRTP : 0)
+                           | (data.probablyIfNaiveSingletone ? IfNaive : 0)
+                           | (data.probablyFlagsNaiveSingletone ? FlagsNaive : 0)
+                           | (data.unknownPatternSingletone ? Unknown : 0);
+        detection.flags = (data.ctorsPrivate ? CtorsPrivate : 0)
+                        | (data.hasDeletedCopyConstuctor ? DeletedCopyConstructor : 0)
+                        | (data.hasDeletedAssigmentOperator ? DeletedAssignment : 0)
+                        | (data.hiddenInstanceMethod ? HiddenInstanceMethod : 0)
+                        | (data.skippedByBudget ? SkippedByBudget : 0)
+                        | (data.smartPointerInstance ? SmartPointerInstance : 0)
+                        | (data.hasFriendFunctionLikelyInstance ? FriendGetInstance : 0);
+        detection.condition = data.conditionPatternInGetInstance;
+        detection.accessCost = data.accessCost;
+        detection.classLocation = locationOf(record);
+        detection.getInstance = data.methodLikeGetInstance 
+            ? locationOf(data.methodLikeGetInstance) : locationOf(data.friendFunctionLikeGetInstance);
+        detection.instanceField = locationOf(data.instanceField);
+        index.add(std::move(detection));
+    }
+
+    void write(StringRef dir, TranslationUnitInfo* info) const {
+        std::string mainFile = mainFileName(SM);
+        if (mainFile.empty()) return;
+        std::string content = index.serialize();
+        if (!DetectionIndexBuilder::writeFile(dir, mainFile, content))
+            llvm::errs() << "singleton-checker: cannot write the detection index to " << dir << "\n";
+        if (info) {
+            info->mainFile = mainFile;
+            info->detectionIndex = std::move(content);
+        }
+    }
+};
+
+class ClassVisitor {
+private:
+    ASTContext *Context;
+    SourceManager* SM;
+    ScopeFilter& scopeFilter;
+    HeaderDeclTracker& headerDecls;
+    ReportWriter& writer;
+    ScanCache& scanCache;
+
+    AnalysisData analysisData;
+    GetInstancePatternAnalyser getInstancePatternAnalyser;
+
+public:
+    struct Verdict {
+        bool singleton = false;
+        const VarDecl* instanceField = nullptr;
+    };
+
+    // Classes rejected by each prefilter tier of analyseClass, before any
+    // function body is looked at, and the ones left for body analysis.
+    struct PrefilterStats {
+        unsigned classes = 0;
+        unsigned byKind = 0;
+        unsigned byCtors = 0;
+        unsigned byCandidates = 0;
+        unsigned bodyAnalysed = 0;
+    };
+
+private:
+    llvm::DenseMap<const CXXRecordDecl*, Verdict> verdicts;
+    DetectionCollector* detections = nullptr;
+    // Per class template pattern: its analysis when it is a CRTP singleton,
+    // shared by every class deriving from one of its specializations.
+    llvm::DenseMap<const CXXRecordDecl*, llvm::Optional<AnalysisData>> crtpPatterns;
+    PrefilterStats prefilter;
+
+private:
+        void registerClassForAnalysisData(CXXRecordDecl* clsAST) 
+        {
+            analysisData.className = clsAST->getNameAsString();
+            analysisData.location = clsAST->getLocation();
+            analysisData.SM = &Context->getSourceManager();
+        }
+
+        bool shouldSkipDeclaration(Decl *decl) 
+        {
+            return scopeFilter.isOutOfScope(decl);
+        }
+public:
+    ClassVisitor(ASTContext *Context, ScopeFilter& scopeFilter, HeaderDeclTracker& headerDecls,
+                 ReportWriter& writer, ScanCache& scanCache, unsigned nodeBudget,
+                 const PatternMatchEngine* matches, FunctionCFGs* cfgs = nullptr) 
+        : Context(Context), scopeFilter(scopeFilter), headerDecls(headerDecls), writer(writer),
+          scanCache(scanCache), getInstancePatternAnalyser(analysisData, nodeBudget, matches, cfgs) {
+        SM = &Context->getSourceManager();
+    }
+
+    void updateFriendGetInstanceCandidate(FunctionDecl* funcFriend) {
+        if (!analysisData.hasFriendFunctionLikelyInstance) {
+            const ScanCache::GetInstanceFindings& findings = scanCache.findingsOf(funcFriend);
+            if (!findings.analysed)
+                return;
+            analysisData.mergeGetInstanceFindings(findings.data);
+            analysisData.hasFriendFunctionLikelyInstance = analysisData.probabalyNaiveSingletone 
+                                                        || analysisData.probablyMayersSingletone;
+            if (analysisData.hasFriendFunctionLikelyInstance) {
+                analysisData.friendFunctionLikeGetInstance = funcFriend;
+            }
+        }
+    }
+
+    template<typename T>
+    void checkObjectViolations(CXXRecordDecl* declaration, T* decl) {
+        ScanCache::InstanceCounts counts = scanCache.instancesIn(decl, declaration);
+        
+        analysisData.amountObjects += counts.statics;
+        
+        if (analysisData.amountObjects > 1 || counts.local) {
+            analysisData.isSingltone = false;
+        }
+    }
+    int countClassStaticObjectInExternal(CXXRecordDecl* targetClass, 
+                                         CXXRecordDecl* currentClass = nullptr) {
+        using AnalysisAlgorithm::countClassStaticObject;
+        int count = 0;
+        
+        if (!currentClass) 
+            currentClass = targetClass;
+        
+        
+        return count;
+    }
+
+    // Base<Class> specialization of a base class with a static member 
+    // function returning Class* or Class&, the shape of a CRTP singleton 
+    // base. Mixins such as enable_shared_from_this<Class> have no such 
+    // function. Explicit specializations are classes of their own, analysed
+    // as such.
+    ClassTemplateSpecializationDecl* crtpSpecialization(const CXXBaseSpecifier& base,
+                                                        const CXXRecordDecl* declaration) {
+        auto* specialization = dyn_cast_or_null<ClassTemplateSpecializationDecl>(
+            base.getType()->getAsCXXRecordDecl());
+        if (!specialization || specialization->isExplicitSpecialization())
+            return nullptr;
+        QualType self = Context->getRecordType(declaration);
+        bool selfArgument = false;
+        for (const TemplateArgument& argument : specialization->getTemplateArgs().asArray())
+            if (argument.getKind() == TemplateArgument::Type
+                && Context->hasSameType(argument.getAsType(), self)) {
+                selfArgument = true;
+                break;
+            }
+        if (!selfArgument)
+            return nullptr;
+        for (const CXXMethodDecl* method : specialization->methods()) {
+            QualType returnType = method->getReturnType();
+            if (method->isStatic() && (returnType->isPointerType() || returnType->isReferenceType())
+                && Context->hasSameType(returnType->getPointeeType().getUnqualifiedType(), self))
+                return specialization;
+        }
+        return nullptr;
+    }
+
+    // Analysis of the CRTP singleton template the class derives from. The
+    // getInstance of the template pattern is analysed once, on the first
+    // derived class, and reused for all the others: the instantiated bodies
+    // of the specializations are never walked.
+    const AnalysisData* crtpBaseOf(CXXRecordDecl* declaration,
+                                   const ClassTemplateSpecializationDecl*& base) {
+        for (const CXXBaseSpecifier& baseSpecifier : declaration->bases()) {
+            ClassTemplateSpecializationDecl* specialization = crtpSpecialization(baseSpecifier, declaration);
+            if (!specialization)
+                continue;
+            CXXRecordDecl* pattern = specialization->getTemplateInstantiationPattern();
+            if (!pattern)
+                pattern = specialization->getSpecializedTemplate()->getTemplatedDecl()->getDefinition();
+            // The lazy analysis must not reach templates the run excludes
+            // (system headers, files outside the project).
+            if (!pattern || shouldSkipDeclaration(pattern))
+                continue;
+
+            auto it = crtpPatterns.find(pattern);
+            if (it == crtpPatterns.end()) {
+                llvm::SaveAndRestore<AnalysisData> derived(analysisData);
+                analyseClass(pattern);
+                it = crtpPatterns.find(pattern);
+            }
+            if (it != crtpPatterns.end() && it->second) {
+                base = specialization;
+                return it->second.getPointer();
+            }
+        }
+        return nullptr;
+    }
+
+    // getInstance of the class is the one of its CRTP base.
+    void inheritCRTPGetInstance(CXXRecordDecl* declaration) {
+        const ClassTemplateSpecializationDecl* base = nullptr;
+        const AnalysisData* pattern = crtpBaseOf(declaration, base);
+        if (!pattern)
+            return;
+        analysisData.mergeGetInstanceFindings(*pattern);
+        analysisData.hasMethodLikelyInstance = true;
+        analysisData.methodLikeGetInstance = pattern->methodLikeGetInstance;
+        analysisData.hiddenInstanceMethod = pattern->hiddenInstanceMethod;
+        analysisData.probabalyCRTPSingletone = true;
+        analysisData.crtpBase = base;
+    }
+
+    // Only a static method, a friend or a CRTP base can provide the
+    // getInstance the verdict requires; a class with none of them is 
+    // rejected on declarations alone, without scanning a body.
+    bool hasGetInstanceCandidate(CXXRecordDecl* declaration) {
+        if (declaration->friend_begin() != declaration->friend_end())
+            return true;
+        for (const CXXBaseSpecifier& base : declaration->bases())
+            if (crtpSpecialization(base, declaration))
+                return true;
+        for (CXXMethodDecl* method : declaration->methods())
+            if (method->isStatic() && getInstancePatternAnalyser.isValidSingletonMethodSignature(method))
+                return true;
+        return false;
+    }
+
+    // Fills analysisData for the class and memoizes the verdict.
+    void analyseClass(CXXRecordDecl *declaration) {
+        using namespace AnalysisAlgorithm;
+
+        llvm::TimeTraceScope classScope("SingletonClass", [&] { return declaration->getNameAsString(); });
+        analysisData.clear();
+        registerClassForAnalysisData(declaration);
+        // A class analysed ahead of its traversal (verdictOf, a CRTP base
+        // pattern) is counted once by the prefilter tiers.
+        const bool tally = verdicts.find(declaration) == verdicts.end();
+        if (tally)
+            ++prefilter.classes;
+
+        auto reject = [&](unsigned& tier) {
+            if (tally)
+                ++tier;
+            analysisData.isSingltone = false;
+            recordVerdict(declaration);
+        };
+
+        // Prefilter, cheapest tiers first: none of them looks at a body.
+        if (declaration->isLambda()) {
+            if (tally)
+                ++NumClassesPrunedByKind;
+            reject(prefilter.byKind);
+            return;
+        }
+
+        // first stage of analysis
+        {
+            llvm::TimeTraceScope stageScope("SingletonCtorScan");
+            for (const auto* c : declaration->ctors()) {
+                if (c->getAccess() == AS_public && !c->isDeleted()) {
+                   analysisData.ctorsPrivate = false; 
+                   break;
+                }
+            }
+        }
+        if (!analysisData.ctorsPrivate) {
+            if (tally)
+                ++NumClassesPrunedByCtors;
+            reject(prefilter.byCtors);
+            return;
+        }
+
+        if (!hasGetInstanceCandidate(declaration)) {
+            if (tally)
+                ++NumClassesPrunedByCandidates;
+            reject(prefilter.byCandidates);
+            return;
+        }
+        if (tally) {
+            ++NumClassesBodyAnalysed;
+            ++prefilter.bodyAnalysed;
+        }
+        
+        llvm::Optional<llvm::TimeTraceScope> stageScope;
+        stageScope.emplace("SingletonMethodLoop");
+        analysisData.hasDeletedCopyConstuctor = true;
+        analysisData.hasDeletedAssigmentOperator = true;
+        for (auto *method : declaration->methods()) {
+            if (method->isStatic() && !analysisData.hasMethodLikelyInstance) { 
+                analysisData.hasMethodLikelyInstance = getInstancePatternAnalyser.isProbablyGetInstanceFunction(method); 
+                if (analysisData.hasMethodLikelyInstance) {
+                    analysisData.methodLikeGetInstance = method;
+                    analysisData.hiddenInstanceMethod = (method->getAccess() != AS_public); 
+                    analysisData.probabalyCRTPSingletone =  method->getReturnType()->isDependentType();
+                }
+                analysisData.hasMethodLikelyInstance &= compareReturnTypeWithRecordType(method, declaration)
+                                                     || analysisData.probabalyCRTPSingletone;
+            }
+                
+            if (CXXConstructorDecl* ctrDecl = dyn_cast<CXXConstructorDecl>(method))
+            {
+                if (ctrDecl->isCopyOrMoveConstructor()) 
+                    analysisData.hasDeletedCopyConstuctor &= ctrDecl->isDeleted();
+            }
+
+            if (method->isCopyAssignmentOperator())
+                analysisData.hasDeletedAssigmentOperator &= method->isDeleted();
+        
+            // second stage of analysis
+            checkObjectViolations(declaration, method);
+        }
+
+
+        if (analysisData.isSingltone && !analysisData.hasMethodLikelyInstance) {
+            stageScope.emplace("SingletonCRTPBase");
+            inheritCRTPGetInstance(declaration);
+        }
+
+        if (!analysisData.isSingltone && tally)
+            ++NumClassesPrunedByMethods;
+
+        // second stage of analysis  
+        if (analysisData.isSingltone) {
+            stageScope.emplace("SingletonInstanceFields");
+            for (auto* field : declaration->decls()) {
+                if (isClassObject(dyn_cast<VarDecl>(field), declaration)) { 
+                    if (++analysisData.amountObjects > 1) {
+                        analysisData.isSingltone = false;
+                        if (tally)
+                            ++NumClassesPrunedByFields;
+                        break;
+                    }
+                }
+            }
+        }
+        // third stage of analysis
+        if (analysisData.isSingltone) {
+            stageScope.emplace("SingletonFriendStage");
+            for (FriendDecl* friendDecl : declaration->friends()) {
+                if (!analysisData.isSingltone) break;
+               
+                if (NamedDecl* nd = friendDecl->getFriendDecl()) {
+                    if (FunctionDecl* funcFriend = dyn_cast<FunctionDecl>(nd)) {
+                        if (compareReturnTypeWithRecordType(funcFriend, declaration)) 
+                           updateFriendGetInstanceCandidate(funcFriend); 
+                        checkObjectViolations(declaration, funcFriend);    
+                    }
+                }
+                else if (TypeSourceInfo* tsi = friendDecl->getFriendType()) {
+                    QualType qt = tsi->getType();
+                    if (const RecordType* rt = qt->getAs<RecordType>()) {
+                        if (CXXRecordDecl* friendClss = dyn_cast<CXXRecordDecl>(rt->getDecl())) { 
+                            checkObjectViolations(declaration, friendClss);
+                            // Already summarised from the template pattern.
+                            if (friendClss == analysisData.crtpBase)
+                                continue;
+                            for (CXXMethodDecl* friendMethod : friendClss->methods())
+                                updateFriendGetInstanceCandidate(friendMethod);
+                        }
+                    }
+                }
+            }
+            if (!analysisData.isSingltone && tally)
+                ++NumClassesPrunedByFriends;
+        }
+        stageScope.reset();
+
+        analysisData.isSingltone &= analysisData.probabalyCRTPSingletone 
+                                || analysisData.probabalyNaiveSingletone 
+                                || analysisData.probablyMayersSingletone 
+                                || analysisData.probabalyNaiveSingletone;
+        recordVerdict(declaration);
+    }
+
+    void recordVerdict(CXXRecordDecl* declaration) {
+        verdicts[declaration] = {bool(analysisData.isSingltone), analysisData.instanceField};
+        if (declaration->getDescribedClassTemplate() 
+            || isa<ClassTemplatePartialSpecializationDecl>(declaration)) {
+            if (analysisData.isSingltone && analysisData.probabalyCRTPSingletone)
+                crtpPatterns[declaration] = analysisData;
+            else
+                crtpPatterns[declaration] = llvm::None;
+        }
+    }
+
+    const PrefilterStats& getPrefilterStats() const { return prefilter; }
+
+    void setDetections(DetectionCollector* collector) { detections = collector; }
+
+    bool VisitCXXRecordDecl(CXXRecordDecl *declaration) {
+        if (shouldSkipDeclaration(declaration))
+            return true;
+
+        ++NumClassesVisited;
+        //declaration->dump();
+        if ((declaration->isEmbeddedInDeclarator() && !declaration->isFreeStanding())
+            || declaration->getFriendObjectKind() != Decl::FOK_None
+            || !declaration->isThisDeclarationADefinition()) {
+            ++NumClassesSkipped;
+            return true;
+        }
+
+        std::string usr;
+        if (!headerDecls.claim(declaration, usr)) {
+            ++NumClassesAlreadyAnalysed;
+            return true;
+        }
+
+        analyseClass(declaration);
+        if (analysisData.isSingltone || analysisData.skippedByBudget) {
+            ++NumClassesReported;
+            if (detections)
+                detections->add(declaration, analysisData);
+            headerDecls.report(usr, [&](llvm::raw_ostream& os) { writer.writeClass(os, analysisData); });
+        }
+        
+        return true;
+    }
+
+    // Verdict of a class whether or not this TU reported it, e.g. a header
+    // class claimed by another TU. Classes out of the scope of the run are
+    // never singletons, as for the traversal.
+    const Verdict& verdictOf(CXXRecordDecl* record) {
+        static const Verdict none;
+        record = record->getDefinition();
+        if (!record || shouldSkipDeclaration(record))
+            return none;
+        auto it = verdicts.find(record);
+        if (it != verdicts.end())
+            return it->second;
+        analyseClass(record);
+        return verdicts[record];
+    }
+
+};
+
+class FunctionVisitor {
+private:
+   ASTContext *Context;
+   HeaderDeclTracker& headerDecls;
+   ReportWriter& writer;
+   AnalysisData analysisData;
+   GetInstancePatternAnalyser getInstancePatternAnalyser;
+
+public:
+    FunctionVisitor(ASTContext *Context, HeaderDeclTracker& headerDecls, ReportWriter& writer,
+                    unsigned nodeBudget, const PatternMatchEngine* matches, FunctionCFGs* cfgs = nullptr) 
+        : Context(Context), headerDecls(headerDecls), writer(writer), 
+          getInstancePatternAnalyser(analysisData, nodeBudget, matches, cfgs) {}
+
+    bool VisitFunctionDecl(FunctionDecl *func) {
+        if (isa<CXXMethodDecl>(func)) {
+            return true;
+        }
+        
+        if (!func->hasBody() || !func->getBody()) {
+            return true;
+        }
+        
+        if (!func->getReturnType()->isPointerType() 
+        &&  !func->getReturnType()->isReferenceType()) {
+            return true;
+        }
+        std::string usr;
+        if (!headerDecls.claim(func, usr))
+            return true;
+
+        ++NumFunctionsVisited;
+        llvm::TimeTraceScope timeScope("SingletonFunctionVisitor", [&] { return func->getNameAsString(); });
+        analysisData.clear();
+        if(getInstancePatternAnalyser.isProbablyGetInstanceFunction(func) 
+           || analysisData.skippedByBudget) {
+            ++NumFunctionsReported;
+            headerDecls.report(usr, [&](llvm::raw_ostream& os) { 
+                writer.writeFunction(os, func, analysisData, Context->getSourceManager()); 
+            });
+        }
+
+        return true;
+    }
+};
+
+// Objects of record type with static storage duration defined in the TU,
+// summarised by record USR for singleton-instances, which counts them
+// across all TUs.
+class InstanceCollector {
+private:
+    SourceManager& SM;
+    InstanceSummary summary;
+
+public:
+    explicit InstanceCollector(SourceManager& SM) : SM(SM) {}
+
+    bool VisitVarDecl(VarDecl* var) {
+        if (!var->hasGlobalStorage() 
+            || var->isThisDeclarationADefinition() != VarDecl::Definition)
+            return true;
+
+        QualType type = var->getType();
+        if (type->isDependentType())
+            return true;
+        const CXXRecordDecl* record = type->getAsCXXRecordDecl();
+        if (!record || SM.isInSystemHeader(record->getLocation()))
+            return true;
+
+        llvm::SmallString<128> recordUSR, instanceUSR;
+        if (index::generateUSRForDecl(record, recordUSR) 
+            || index::generateUSRForDecl(var, instanceUSR))
+            return true;
+
+        PresumedLoc loc = SM.getPresumedLoc(SM.getExpansionLoc(var->getLocation()));
+        std::string location = loc.isValid() 
+            ? std::string(loc.getFilename()) + ":" + std::to_string(loc.getLine()) : "";
+        summary.add({recordUSR.str().str(), record->getQualifiedNameAsString(), 
+                     instanceUSR.str().str(), std::move(location)});
+        return true;
+    }
+
+    void write(StringRef dir, TranslationUnitInfo* info) const {
+        std::string mainFile = mainFileName(SM);
+        if (mainFile.empty()) return;
+        std::string content = summary.serialize();
+        if (!InstanceSummary::writeFile(dir, mainFile, content))
+            llvm::errs() << "singleton-checker: cannot write the instance summary to " << dir << "\n";
+        if (info) {
+            info->mainFile = mainFile;
+            info->instanceSummary = std::move(content);
+        }
+    }
+};
+
+// Calls made inside loops, reported once the TU is traversed for the callees
+// the analyser recognises as getInstance functions. The callee is judged by
+// its own body (ScanCache findings), so calls of a header getInstance are
+// found even if another TU reported its class.
+class HotCallSiteCollector {
+private:
+    const SourceManager& SM;
+    HeaderDeclTracker& headerDecls;
+    ReportWriter& writer;
+    ScanCache& scanCache;
+
+    std::vector<HotCallSite> sites;
+    llvm::DenseMap<const FunctionDecl*, bool> isGetInstanceMemo;
+
+    bool isGetInstance(const FunctionDecl* callee)
+    {
+        auto inserted = isGetInstanceMemo.try_emplace(callee, false);
+        if (!inserted.second)
+            return inserted.first->second;
+
+        auto* def = const_cast<FunctionDecl*>(callee->getDefinition());
+        if (!def)
+            return false;
+        if (auto* method = dyn_cast<CXXMethodDecl>(def)) {
+            if (!method->isStatic())
+                return false;
+            if (!method->getReturnType()->isDependentType()
+                && !AnalysisAlgorithm::compareReturnTypeWithRecordType(method, method->getParent()))
+                return false;
+        }
+        const ScanCache::GetInstanceFindings& findings = scanCache.findingsOf(def);
+        return isGetInstanceMemo[callee] = findings.analysed && !findings.data.skippedByBudget
+                                        && (findings.data.probabalyNaiveSingletone 
+                                            || findings.data.probablyMayersSingletone);
+    }
+
+public:
+    HotCallSiteCollector(const SourceManager& SM, HeaderDeclTracker& headerDecls,
+                         ReportWriter& writer, ScanCache& scanCache)
+        : SM(SM), headerDecls(headerDecls), writer(writer), scanCache(scanCache) {}
+
+    void add(const CallExpr* call, const FunctionDecl* caller, unsigned loopDepth)
+    {
+        const FunctionDecl* callee = call->getDirectCallee();
+        if (!callee || !caller)
+            return;
+        QualType type = callee->getReturnType();
+        if (!type->isPointerType() && !type->isReferenceType())
+            return;
+        ++NumLoopCallsSeen;
+        // Calls of a template specialization are judged by the pattern.
+        if (const FunctionDecl* pattern = callee->getTemplateInstantiationPattern())
+            callee = pattern;
+        sites.push_back({call, caller, callee->getCanonicalDecl(), loopDepth});
+    }
+
+    // Reports of one caller are claimed and written together, in the order
+    // of the calls; callers in the order they were first seen.
+    void report()
+    {
+        llvm::TimeTraceScope timeScope("SingletonHotCallSites");
+        llvm::DenseMap<const FunctionDecl*, std::vector<const HotCallSite*>> byCaller;
+        std::vector<const FunctionDecl*> callers;
+        for (const HotCallSite& site : sites) {
+            if (!isGetInstance(site.getInstance))
+                continue;
+            std::vector<const HotCallSite*>& callerSites = byCaller[site.caller];
+            if (callerSites.empty())
+                callers.push_back(site.caller);
+            callerSites.push_back(&site);
+        }
+
+        for (const FunctionDecl* caller : callers) {
+            std::string usr;
+            if (!headerDecls.claim(caller, usr, "#loop-calls"))
+                continue;
+            const std::vector<const HotCallSite*>& callerSites = byCaller[caller];
+            NumHotCallsReported += callerSites.size();
+            headerDecls.report(usr, [&](llvm::raw_ostream& os) {
+                for (const HotCallSite* site : callerSites)
+                    writer.writeHotCallSite(os, *site, SM);
+            });
+        }
+        sites.clear();
+    }
+};
+
+// Startup cost inventory: definitions of objects with static storage 
+// duration (not function-local) that are a singleton instance, i.e. the 
+// instance field of a singleton class or an object of its type, and run 
+// code before main: a dynamic initializer or a destructor registration.
+// Classes are judged by ClassVisitor once the TU is traversed, whichever
+// TU reports them.
+class StartupAuditor {
+private:
+    ASTContext& Context;
+    HeaderDeclTracker& headerDecls;
+    ReportWriter& writer;
+    ClassVisitor& classes;
+    std::vector<VarDecl*> definitions;
+
+    CXXRecordDecl* singletonOf(VarDecl* var)
+    {
+        if (var->isStaticDataMember()) {
+            auto* owner = cast<CXXRecordDecl>(var->getDeclContext());
+            const ClassVisitor::Verdict& verdict = classes.verdictOf(owner);
+            bool isInstance = verdict.instanceField 
+                && verdict.instanceField->getCanonicalDecl() == var->getCanonicalDecl();
+            if (verdict.singleton && (isInstance || AnalysisAlgorithm::isClassObject(var, owner)))
+                return owner;
+        }
+        CXXRecordDecl* record = var->getType()->getAsCXXRecordDecl();
+        if (record && !Context.getSourceManager().isInSystemHeader(record->getLocation())
+            && classes.verdictOf(record).singleton)
+            return record;
+        return nullptr;
+    }
+
+    // The constructor of the singleton if the initializer calls it (e.g. 
+    // through new or inside a smart pointer), the outermost one otherwise.
+    static const CXXConstructorDecl* constructorOf(Expr* init, const CXXRecordDecl* singleton)
+    {
+        const CXXConstructExpr* outermost = nullptr;
+        const CXXConstructExpr* own = nullptr;
+        unsigned budget = std::numeric_limits<unsigned>::max();
+        bool exhausted = false;
+        AnalysisAlgorithm::findStmt(init, [&](Stmt* stmt) {
+            auto* construct = dyn_cast<CXXConstructExpr>(stmt);
+            if (!construct) return false;
+            if (!outermost) outermost = construct;
+            if (construct->getConstructor()->getParent()->getCanonicalDecl() == singleton->getCanonicalDecl())
+                own = construct;
+            return own != nullptr;
+        }, budget, exhausted);
+        const CXXConstructExpr* construct = own ? own : outermost;
+        return construct ? construct->getConstructor() : nullptr;
+    }
+
+public:
+    StartupAuditor(ASTContext& Context, HeaderDeclTracker& headerDecls, ReportWriter& writer,
+                   ClassVisitor& classes)
+        : Context(Context), headerDecls(headerDecls), writer(writer), classes(classes) {}
+
+    bool VisitVarDecl(VarDecl* var) {
+        if (var->hasGlobalStorage() && !var->isStaticLocal()
+            && var->isThisDeclarationADefinition() == VarDecl::Definition
+            && !var->getDeclContext()->isDependentContext() && !var->getType()->isDependentType())
+            definitions.push_back(var);
+        return true;
+    }
+
+    void report()
+    {
+        llvm::TimeTraceScope timeScope("SingletonStartupAudit");
+        for (VarDecl* var : definitions) {
+            StartupInit init;
+            init.instance = var;
+            Expr* initExpr = var->getInit();
+            init.dynamicInit = initExpr 
+                && !initExpr->isConstantInitializer(Context, var->getType()->isReferenceType());
+            init.registersDestructor = var->getType().isDestructedType();
+            if (!init.dynamicInit && !init.registersDestructor)
+                continue;
+
+            CXXRecordDecl* singleton = singletonOf(var);
+            if (!singleton)
+                continue;
+            init.singleton = singleton;
+            if (initExpr)
+                init.constructor = constructorOf(initExpr, singleton);
+
+            std::string usr;
+            if (!headerDecls.claim(var, usr, "#startup"))
+                continue;
+            ++NumStartupInitsReported;
+            headerDecls.report(usr, [&](llvm::raw_ostream& os) {
+                writer.writeStartupInit(os, init, Context.getSourceManager());
+            });
+        }
+        definitions.clear();
+    }
+};
+
+// Single traversal of the TU: every declaration is visited once and 
+// dispatched to the class and free function analysers.
+// A TU is analysed on one thread: ASTContext, SourceManager, ScanCache and
+// FunctionCFGs are not thread safe, and even reads of the AST may build types,
+// evaluate initializers or deserialize declarations. The tool parallelises
+// across TUs, each with its own CompilerInstance; only AnalyzedRegistry and
+// ResultCache are shared between them.
+class SingletonASTVisitor : public RecursiveASTVisitor<SingletonASTVisitor> {
+    ScopeFilter Filter;
+    HeaderDeclTracker HeaderDecls;
+    std::unique_ptr<PatternMatchEngine> Matches;
+    std::unique_ptr<FunctionCFGs> CFGs;
+    ScanCache Scans;
+    ClassVisitor ClsVisitor;
+    FunctionVisitor FuncVisitor;
+    std::unique_ptr<InstanceCollector> Instances;
+    std::unique_ptr<DetectionCollector> Detections;
+    HotCallSiteCollector HotCalls;
+    std::unique_ptr<StartupAuditor> Startup;
+
+    // Function (or lambda) being traversed and the number of its loops 
+    // repeating the current statement.
+    const FunctionDecl* CurrentFunction = nullptr;
+    unsigned LoopDepth = 0;
+
+    bool traverseIterations(std::initializer_list<Stmt*> Parts) {
+        llvm::SaveAndRestore<unsigned> Depth(LoopDepth, LoopDepth + 1);
+        for (Stmt* Part : Parts)
+            if (!TraverseStmt(Part))
+                return false;
+        return true;
+    }
+
+public:
+    SingletonASTVisitor(ASTContext *Context, llvm::raw_ostream& OS, const CheckerOptions& Opts,
+                        AnalyzedRegistry* Registry, TranslationUnitInfo* Info, ReportWriter& Writer) 
+        : Filter(Context->getSourceManager(), Opts), 
+          HeaderDecls(Context->getSourceManager(), OS, Registry, Info),
+          Matches(Opts.engine == AnalysisEngine::Matchers ? std::make_unique<PatternMatchEngine>() : nullptr),
+          CFGs(Opts.engine == AnalysisEngine::CFG ? std::make_unique<FunctionCFGs>(*Context) : nullptr),
+          Scans(Opts.nodeBudget, Matches.get(), CFGs.get()),
+          ClsVisitor(Context, Filter, HeaderDecls, Writer, Scans, Opts.nodeBudget, Matches.get(), CFGs.get()), 
+          FuncVisitor(Context, HeaderDecls, Writer, Opts.nodeBudget, Matches.get(), CFGs.get()),
+          Instances(Opts.instanceSummaryDir.empty() 
+                    ? nullptr : std::make_unique<InstanceCollector>(Context->getSourceManager())),
+          Detections(Opts.detectionIndexDir.empty() 
+                     ? nullptr : std::make_unique<DetectionCollector>(Context->getSourceManager())),
+          HotCalls(Context->getSourceManager(), HeaderDecls, Writer, Scans),
+          Startup(Opts.startupAudit 
+                  ? std::make_unique<StartupAuditor>(*Context, HeaderDecls, Writer, ClsVisitor) : nullptr) {
+        ClsVisitor.setDetections(Detections.get());
+    }
+
+    // Reports that need the whole TU, after its traversal.
+    void finish() {
+        HotCalls.report();
+        if (Startup)
+            Startup->report();
+    }
+
+    const ScanCache& getScanCache() const { return Scans; }
+    const ClassVisitor& getClassVisitor() const { return ClsVisitor; }
+
+    // With the matcher engine the MatchFinder pass is the only traversal of
+    // the TU; the candidates it collected are dispatched in the same order
+    // the traversal below would visit them.
+    void analyse(ASTContext& Context) {
+        if (!Matches) {
+            TraverseDecl(Context.getTranslationUnitDecl());
+            finish();
+            return;
+        }
+        {
+            llvm::TimeTraceScope TraceScope("SingletonMatchFinder");
+            std::vector<Decl*> Scope;
+            for (Decl* D : Context.getTranslationUnitDecl()->decls()) {
+                if (Filter.isOutOfScope(D)) {
+                    ++NumSubtreesPruned;
+                    continue;
+                }
+                Scope.push_back(D);
+            }
+            Matches->match(Context, Scope);
+        }
+        for (Decl* D : Matches->getCandidates()) {
+            if (Filter.isOutOfScope(D))
+                continue;
+            if (auto* Record = dyn_cast<CXXRecordDecl>(D))
+                ClsVisitor.VisitCXXRecordDecl(Record);
+            else if (auto* Func = dyn_cast<FunctionDecl>(D))
+                FuncVisitor.VisitFunctionDecl(Func);
+            else if (auto* Var = dyn_cast<VarDecl>(D))
+                VisitVarDecl(Var);
+        }
+        for (const HotCallSite& Site : Matches->getLoopCalls())
+            if (!Filter.isOutOfScope(Site.caller))
+                HotCalls.add(Site.call, Site.caller, Site.loopDepth);
+        finish();
+    }
+
+    // Top level declarations of a serialized AST, only these are traversed.
+    void analyseDecls(ArrayRef<Decl*> Decls) {
+        for (Decl* D : Decls)
+            TraverseDecl(D);
+        finish();
+    }
+
+    // Out of scope subtrees (e.g. namespace std of a system header) are 
+    // never entered, so neither analyser sees their declarations.
+    bool TraverseDecl(Decl *D) {
+        if (D && !isa<TranslationUnitDecl>(D) && Filter.isOutOfScope(D)) {
+            ++NumSubtreesPruned;
+            return true;
+        }
+        if (auto* Func = dyn_cast_or_null<FunctionDecl>(D)) {
+            llvm::SaveAndRestore<const FunctionDecl*> Function(CurrentFunction, Func);
+            llvm::SaveAndRestore<unsigned> Depth(LoopDepth, 0);
+            return RecursiveASTVisitor<SingletonASTVisitor>::TraverseDecl(D);
+        }
+        return RecursiveASTVisitor<SingletonASTVisitor>::TraverseDecl(D);
+    }
+
+    bool TraverseLambdaExpr(LambdaExpr *S, DataRecursionQueue *Queue = nullptr) {
+        llvm::SaveAndRestore<const FunctionDecl*> Function(CurrentFunction, S->getCallOperator());
+        llvm::SaveAndRestore<unsigned> Depth(LoopDepth, 0);
+        return RecursiveASTVisitor<SingletonASTVisitor>::TraverseLambdaExpr(S, Queue);
+    }
+
+    // Loops: what HotCallSite::runsPerIteration counts is traversed one 
+    // level deeper.
+    bool TraverseForStmt(ForStmt *S, DataRecursionQueue * = nullptr) {
+        return TraverseStmt(S->getInit())
+            && traverseIterations({S->getConditionVariableDeclStmt(), S->getCond(), 
+                                   S->getInc(), S->getBody()});
+    }
+
+    bool TraverseWhileStmt(WhileStmt *S, DataRecursionQueue * = nullptr) {
+        return traverseIterations({S->getConditionVariableDeclStmt(), S->getCond(), S->getBody()});
+    }
+
+    bool TraverseDoStmt(DoStmt *S, DataRecursionQueue * = nullptr) {
+        return traverseIterations({S->getBody(), S->getCond()});
+    }
+
+    bool TraverseCXXForRangeStmt(CXXForRangeStmt *S, DataRecursionQueue * = nullptr) {
+        return TraverseStmt(S->getInit()) && TraverseStmt(S->getRangeInit())
+            && traverseIterations({S->getLoopVarStmt(), S->getBody()});
+    }
+
+    bool VisitCallExpr(CallExpr *call) {
+        if (LoopDepth)
+            HotCalls.add(call, CurrentFunction, LoopDepth);
+        return true;
+    }
+
+    bool VisitCXXRecordDecl(CXXRecordDecl *declaration) {
+        return ClsVisitor.VisitCXXRecordDecl(declaration);
+    }
+
+    bool VisitFunctionDecl(FunctionDecl *func) {
+        return FuncVisitor.VisitFunctionDecl(func);
+    }
+
+    bool VisitVarDecl(VarDecl *var) {
+        if (Instances)
+            Instances->VisitVarDecl(var);
+        if (Startup)
+            Startup->VisitVarDecl(var);
+        return true;
+    }
+
+    const InstanceCollector* getInstanceCollector() const { return Instances.get(); }
+    const DetectionCollector* getDetectionCollector() const { return Detections.get(); }
+};
+
+class ClassVisitorASTConsumer : public ASTConsumer {
+    void collectDependencies(ASTContext &Context)
+    {
+        SourceManager& SM = Context.getSourceManager();
+        for (auto it = SM.fileinfo_begin(); it != SM.fileinfo_end(); ++it) {
+            llvm::SmallString<256> path(it->first->getName());
+            SM.getFileManager().makeAbsolutePath(path);
+            Info->dependencies.push_back(std::string(path.str()));
+        }
+        llvm::sort(Info->dependencies);
+    }
+
+    // Declarations of an AST file are deserialized lazily, when first
+    // touched. With the main file scope only the file-level declarations
+    // of the main file region are read; other scopes take the local top
+    // level declarations and let TraverseDecl prune them. Declarations of
+    // namespaces are listed as well, keep the TU level ones only.
+    std::vector<Decl*> selectSerializedDecls(ASTUnit& AST)
+    {
+        if (Opts.scope == CheckerOptions::MainFileOnly && AST.getSourceManager().getMainFileID().isValid())
+            return mainFileDecls(AST);
+        std::vector<Decl*> Decls;
+        AST.visitLocalTopLevelDecls(&Decls, [](void* Ctx, const Decl* D) {
+            static_cast<std::vector<Decl*>*>(Ctx)->push_back(const_cast<Decl*>(D));
+            return true;
+        });
+        llvm::erase_if(Decls, [](const Decl* D) {
+            return !isa<TranslationUnitDecl>(D->getLexicalDeclContext());
+        });
+        return Decls;
+    }
+
+    // TU level declarations of the main file region, nothing is read from
+    // the AST file or the preamble for the headers.
+    static std::vector<Decl*> mainFileDecls(ASTUnit& AST)
+    {
+        SourceManager& SM = AST.getSourceManager();
+        FileID Main = SM.getMainFileID();
+        llvm::SmallVector<Decl*, 64> Found;
+        AST.findFileRegionDecls(Main, 0, SM.getFileIDSize(Main), Found);
+        std::vector<Decl*> Decls(Found.begin(), Found.end());
+        llvm::erase_if(Decls, [](const Decl* D) {
+            return !isa<TranslationUnitDecl>(D->getLexicalDeclContext());
+        });
+        return Decls;
+    }
+
+    template<typename Analyse>
+    void run(ASTContext &Context, Analyse analyse)
+    {
+        // Reported by -ftime-report in the "Singleton checker" group.
+        llvm::NamedRegionTimer T("analysis", "Singleton analysis", 
+                                 "singleton-checker", "Singleton checker",
+                                 llvm::TimePassesIsEnabled);
+        // Shown in the Chrome trace of -ftime-trace, stages nest below it.
+        llvm::TimeTraceScope TraceScope("SingletonAnalysis");
+        analyse();
+
+        if (const InstanceCollector* Instances = Visitor.getInstanceCollector())
+            Instances->write(Opts.instanceSummaryDir, Info);
+        if (const DetectionCollector* Detections = Visitor.getDetectionCollector())
+            Detections->write(Opts.detectionIndexDir, Info);
+
+        if (Opts.printCacheStats) {
+            const ScanCache& scans = Visitor.getScanCache();
+            unsigned lookups = scans.getHits() + scans.getMisses();
+            llvm::errs() << "singleton-checker: scan cache hits " << scans.getHits() 
+                         << ", misses " << scans.getMisses() << ", hit rate " 
+                         << (lookups ? 100 * scans.getHits() / lookups : 0) << "%\n";
+        }
+
+        if (Opts.printPrefilterStats) {
+            const ClassVisitor::PrefilterStats& stats = Visitor.getClassVisitor().getPrefilterStats();
+            llvm::errs() << "singleton-checker: prefilter rejected " 
+                         << stats.classes - stats.bodyAnalysed << " of " << stats.classes 
+                         << " classes (kind " << stats.byKind << ", ctors " << stats.byCtors 
+                         << ", candidates " << stats.byCandidates << "), " << stats.bodyAnalysed 
+                         << " reached body analysis ("
+                         << llvm::format("%.1f", stats.classes ? 100.0 * stats.bodyAnalysed / stats.classes : 0.0)
+                         << "%)\n";
+        }
+        
+        if (Info)
+            collectDependencies(Context);
+        else
+            Writer->writeDocument(OS, RecordsOS.str());
+    }
+
+public:
+    // Without Info (plugin mode) the consumer owns the output document: records
+    // are buffered and written at once at the end of the TU. Otherwise they go
+    // straight to OS and the driver assembles the document.
+    ClassVisitorASTConsumer(ASTContext *Context, llvm::raw_ostream& OS, const CheckerOptions& Opts,
+                            TranslationUnitInfo* Info = nullptr, AnalyzedRegistry* Registry = nullptr) 
+        : Opts(Opts), Info(Info), OS(OS), RecordsOS(Records),
+          OwnRegistry(!Registry && !Opts.registryDir.empty() 
+                      ? std::make_unique<AnalyzedRegistry>(Opts.registryDir, Opts.registryRun) : nullptr),
+          Writer(ReportWriter::create(Opts.format)),
+          Visitor(Context, Info ? OS : RecordsOS, this->Opts, 
+                  Registry ? Registry : OwnRegistry.get(), Info, *Writer) {}
+
+    void HandleTranslationUnit(ASTContext &Context) override {
+        run(Context, [&] { Visitor.analyse(Context); });
+    }
+
+    // AST file (-emit-ast, PCH) loaded by ASTUnit instead of a parse. The
+    // matcher engine needs the whole TU and deserializes everything.
+    void HandleSerializedAST(ASTUnit& AST) {
+        ASTContext& Context = AST.getASTContext();
+        if (Opts.engine == AnalysisEngine::Matchers) {
+            HandleTranslationUnit(Context);
+            return;
+        }
+        run(Context, [&] { Visitor.analyseDecls(selectSerializedDecls(AST)); });
+    }
+
+    // Unit parsed by ASTUnit on top of a precompiled preamble. Its top level
+    // declarations (top_level_begin()) include those the preamble recorded
+    // for every header, deserialized on access; only the main file region
+    // is looked up, so the headers are neither read again nor analysed.
+    void HandleParsedUnit(ASTUnit& AST) {
+        ASTContext& Context = AST.getASTContext();
+        if (Opts.engine == AnalysisEngine::Matchers) {
+            HandleTranslationUnit(Context);
+            return;
+        }
+        std::vector<Decl*> Decls = mainFileDecls(AST);
+        run(Context, [&] { Visitor.analyseDecls(Decls); });
+    }
+
+private:
+    // Own copy: an -add-plugin action is destroyed before the consumer runs.
+    const CheckerOptions Opts;
+    TranslationUnitInfo* Info;
+    llvm::raw_ostream& OS;
+    std::string Records;
+    llvm::raw_string_ostream RecordsOS;
+    std::unique_ptr<AnalyzedRegistry> OwnRegistry;
+    std::unique_ptr<ReportWriter> Writer;
+    SingletonASTVisitor Visitor;
+};
+
+class ClassVisitorPlugin : public PluginASTAction {
+    llvm::raw_ostream* OS = &llvm::outs();
+    CheckerOptions Opts;
+    TranslationUnitInfo* Info = nullptr;
+    AnalyzedRegistry* Registry = nullptr;
+
+public:
+    ClassVisitorPlugin() = default;
+    // Used by the standalone driver to collect the report of one TU 
+    // into its own buffer instead of stdout.
+    ClassVisitorPlugin(llvm::raw_ostream& OS, const CheckerOptions& Opts, 
+                       TranslationUnitInfo* Info = nullptr, AnalyzedRegistry* Registry = nullptr) 
+        : OS(&OS), Opts(Opts), Info(Info), Registry(Registry) {}
+
+    std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance &CI,
+                                                   StringRef InFile) override {
+        return std::make_unique<ClassVisitorASTConsumer>(&CI.getASTContext(), *OS, Opts, Info, Registry);
+    }
+
+    // -plugin class-visitor replaces the main action (-fsyntax-only); 
+    // -add-plugin class-visitor runs after it, e.g. next to codegen of -c.
+    ActionType getActionType() override { return CmdlineAfterMainAction; }
+
+    bool ParseArgs(const CompilerInstance &CI,
+                  const std::vector<std::string> &args) override {
+        for (const auto &Arg : args) {
+            StringRef arg(Arg);
+            // -fplugin-arg-singleton-scope=main arrives as "scope=main".
+            arg.consume_front("-");
+            if (arg == "help") {
+                PrintHelp(llvm::errs());
+                return false;
+            }
+            if (arg.consume_front("scope=")) {
+                auto scope = CheckerOptions::parseScope(arg);
+                if (!scope) {
+                    llvm::errs() << "class-visitor: unknown scope '" << arg << "'\n";
+                    return false;
+                }
+                Opts.scope = *scope;
+            }
+            else if (arg.consume_front("project-root=")) {
+                Opts.setProjectRoot(arg);
+            }
+            else if (arg.consume_front("registry=")) {
+                Opts.registryDir = arg.str();
+            }
+            else if (arg.consume_front("registry-run=")) {
+                Opts.registryRun = arg.str();
+            }
+            else if (arg.consume_front("instance-summary=")) {
+                Opts.instanceSummaryDir = arg.str();
+            }
+            else if (arg.consume_front("detection-index=")) {
+                Opts.detectionIndexDir = arg.str();
+            }
+            else if (arg.consume_front("node-budget=")) {
+                if (arg.getAsInteger(10, Opts.nodeBudget)) {
+                    llvm::errs() << "class-visitor: invalid node budget '" << arg << "'\n";
+                    return false;
+                }
+            }
+            else if (arg.consume_front("engine=")) {
+                auto engine = parseAnalysisEngine(arg);
+                if (!engine) {
+                    llvm::errs() << "class-visitor: unknown engine '" << arg << "'\n";
+                    return false;
+                }
+                Opts.engine = *engine;
+            }
+            else if (arg == "print-cache-stats") {
+                Opts.printCacheStats = true;
+            }
+            else if (arg == "print-prefilter-stats") {
+                Opts.printPrefilterStats = true;
+            }
+            else if (arg == "startup-audit") {
+                Opts.startupAudit = true;
+            }
+            else if (arg.consume_front("format=")) {
+                auto format = parseOutputFormat(arg);
+                if (!format) {
+                    llvm::errs() << "class-visitor: unknown format '" << arg << "'\n";
+                    return false;
+                }
+                Opts.format = *format;
+            }
+            else {
+                llvm::errs() << "class-visitor: unknown argument '" << Arg << "'\n";
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void PrintHelp(llvm::raw_ostream &ros) {
+        ros << "Class visitor plugin\n";
+        ros << "Prints information about classes and their methods\n";
+        ros << "Arguments go through -plugin-arg-class-visitor, or -fplugin-arg-singleton-<arg>\n";
+        ros << "when loaded with -fplugin= into a normal compilation (leading '-' optional)\n";
+        ros << "  -scope=main|project|all   declarations to analyse (default: main)\n";
+        ros << "  -project-root=<dir>       with -scope=project, only headers under <dir>\n";
+        ros << "  -registry=<dir>           analyse each header declaration once per build\n";
+        ros << "  -registry-run=<id>        build run of the registry claims (default: the directory itself)\n";
+        ros << "  -format=text|jsonl|sarif  report format (default: text)\n";
+        ros << "  -node-budget=<n>          give up bodies costing more than <n> statements\n";
+        ros << "  -instance-summary=<dir>   write the static objects of the TU for singleton-instances\n";
+        ros << "  -detection-index=<dir>    write the reported classes of the TU for singleton-query\n";
+        ros << "  -engine=visitor|matchers|cfg  getInstance detection engine (default: visitor)\n";
+        ros << "  -print-cache-stats        print hit rate of the body scan cache\n";
+        ros << "  -print-prefilter-stats    print classes rejected by each prefilter tier\n";
+        ros << "  -startup-audit            report singleton instances initialized before main\n";
+    }
+};
+
+// Same analysis added after the main action of every compilation that loads
+// the plugin, so -fplugin=SingletonChecker.so on the normal -c compile 
+// reuses its parse. The name has no dash: -fplugin-arg-<name>-<arg> ends 
+// the name at the first one.
+class CompilePlugin : public ClassVisitorPlugin {
+public:
+    ActionType getActionType() override { return AddAfterMainAction; }
+
+    bool ParseArgs(const CompilerInstance &CI, const std::vector<std::string> &args) override {
+        // Already the main action of this compilation (-plugin class-visitor).
+        const FrontendOptions& FrontendOpts = CI.getFrontendOpts();
+        if (FrontendOpts.ProgramAction == frontend::PluginAction 
+            && FrontendOpts.ActionName == "class-visitor")
+            return false;
+        if (llvm::is_contained(FrontendOpts.AddPluginActions, "class-visitor"))
+            return false;
+        return ClassVisitorPlugin::ParseArgs(CI, args);
+    }
+};
+
+} // namespace SingletonChecker
+
+#undef DEBUG_TYPE
+
+#endif // SINGLETON_CHECKER_H
@@ -0,0 +1,101 @@
+// Client of singleton-checkerd: prints the current report of every given
+// file, or stops the server.
+//
+//   singleton-checker-client [-socket=<path>] <file>...
+//   singleton-checker-client [-socket=<path>] -shutdown
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Sends one request line and copies the answer to stdout.
+bool query(const std::string& socketPath, const std::string& request)
+{
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path)) {
+        std::cerr << "singleton-checker-client: socket path too long\n";
+        return false;
+    }
+    std::memcpy(address.sun_path, socketPath.data(), socketPath.size());
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        std::cerr << "singleton-checker-client: cannot connect to " << socketPath << ": "
+                  << std::strerror(errno) << "\n";
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    std::string line = request + "\n";
+    const char* data = line.data();
+    size_t left = line.size();
+    while (left) {
+        ssize_t written = write(fd, data, left);
+        if (written <= 0) {
+            close(fd);
+            return false;
+        }
+        data += written;
+        left -= written;
+    }
+
+    bool ok = true;
+    char buffer[4096];
+    ssize_t size;
+    std::string head;
+    while ((size = read(fd, buffer, sizeof(buffer))) > 0) {
+        if (head.size() < 7)
+            head.append(buffer, size);
+        std::cout.write(buffer, size);
+    }
+    close(fd);
+    if (head.compare(0, 7, "error: ") == 0)
+        ok = false;
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string socketPath = ".singleton-checker.sock";
+    std::vector<std::string> requests;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 8, "-socket=") == 0) {
+            socketPath = arg.substr(8);
+        }
+        else if (arg == "-shutdown") {
+            requests.push_back("!shutdown");
+        }
+        else {
+            // The server may run in another directory.
+            char resolved[PATH_MAX];
+            if (!realpath(arg.c_str(), resolved)) {
+                std::cerr << "singleton-checker-client: " << arg << ": " << std::strerror(errno) << "\n";
+                return 1;
+            }
+            requests.push_back(resolved);
+        }
+    }
+    if (requests.empty()) {
+        std::cerr << "usage: singleton-checker-client [-socket=<path>] <file>... | -shutdown\n";
+        return 1;
+    }
+
+    bool ok = true;
+    for (const std::string& request : requests)
+        ok &= query(socketPath, request);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,349 @@
+#include "SingletonChecker.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Frontend/CompilerInvocation.h"
+#include "clang/Tooling/ArgumentsAdjusters.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+
+using namespace clang::tooling;
+using namespace SingletonChecker;
+
+static llvm::cl::OptionCategory ServerCategory("singleton-checkerd options");
+
+static llvm::cl::opt<std::string> SocketPath(
+    "socket",
+    llvm::cl::desc("Unix socket to serve reports on"),
+    llvm::cl::init(".singleton-checker.sock"),
+    llvm::cl::cat(ServerCategory));
+
+static llvm::cl::opt<unsigned> PollIntervalMs(
+    "poll-ms",
+    llvm::cl::desc("Interval of the file change check in milliseconds"),
+    llvm::cl::init(250),
+    llvm::cl::cat(ServerCategory));
+
+static llvm::cl::opt<unsigned> RequestTimeoutMs(
+    "request-timeout-ms",
+    llvm::cl::desc("Time a client has to send its request before the connection is dropped"),
+    llvm::cl::init(2000),
+    llvm::cl::cat(ServerCategory));
+
+static llvm::cl::opt<unsigned> MaxFiles(
+    "max-files",
+    llvm::cl::desc("Files kept parsed with their preamble, least recently requested are dropped"),
+    llvm::cl::init(32),
+    llvm::cl::cat(ServerCategory));
+
+static llvm::cl::opt<OutputFormat> Format(
+    "format",
+    llvm::cl::desc("Report format"),
+    llvm::cl::values(
+        clEnumValN(OutputFormat::Text, "text", "Human readable report"),
+        clEnumValN(OutputFormat::JSONLines, "jsonl", "One JSON object per detection"),
+        clEnumValN(OutputFormat::SARIF, "sarif", "SARIF 2.1.0 log")),
+    llvm::cl::init(OutputFormat::Text),
+    llvm::cl::cat(ServerCategory));
+
+static llvm::cl::extrahelp CommonHelp(CommonOptionsParser::HelpMessage);
+static llvm::cl::extrahelp MoreHelp(
+    "\nKeeps recently requested files parsed on top of a precompiled preamble and\n"
+    "re-analyses the main file whenever it changes. Query with singleton-checker-client.\n");
+
+namespace {
+
+// Files requested by clients, each kept as an ASTUnit with a precompiled
+// preamble. A change of the file (or of one of its dependencies) triggers
+// ASTUnit::Reparse, which reuses the preamble while the includes are the
+// same, and the main file declarations are analysed again.
+class AnalysisServer {
+    struct WatchedFile {
+        std::unique_ptr<ASTUnit> AST;
+        std::string Report;
+        std::vector<std::pair<std::string, llvm::sys::TimePoint<>>> Stamps;
+        uint64_t LastUse = 0;
+        // The last reparse failed, Report is out of date until one succeeds.
+        bool Failed = false;
+    };
+
+    const CompilationDatabase& Compilations;
+    const CheckerOptions& Opts;
+    std::string ResourceDir;
+    std::shared_ptr<PCHContainerOperations> PCHOperations = std::make_shared<PCHContainerOperations>();
+
+    // ASTUnit is not thread safe, requests and the watcher take turns.
+    std::mutex Mutex;
+    llvm::StringMap<WatchedFile> Files;
+    uint64_t Clock = 0;
+
+    static llvm::sys::TimePoint<> modificationTime(StringRef Path)
+    {
+        llvm::sys::fs::file_status Status;
+        if (llvm::sys::fs::status(Path, Status))
+            return llvm::sys::TimePoint<>();
+        return Status.getLastModificationTime();
+    }
+
+    bool isStale(const WatchedFile& File) const
+    {
+        for (const auto& Stamp : File.Stamps)
+            if (modificationTime(Stamp.first) != Stamp.second)
+                return true;
+        return false;
+    }
+
+    void analyse(WatchedFile& File)
+    {
+        std::string Records;
+        llvm::raw_string_ostream OS(Records);
+        TranslationUnitInfo Info;
+        {
+            ClassVisitorASTConsumer Consumer(&File.AST->getASTContext(), OS, Opts, &Info);
+            Consumer.HandleParsedUnit(*File.AST);
+        }
+        OS.flush();
+
+        File.Report.clear();
+        llvm::raw_string_ostream ReportOS(File.Report);
+        ReportWriter::create(Opts.format)->writeDocument(ReportOS, Records);
+        ReportOS.flush();
+
+        File.Stamps.clear();
+        if (!llvm::is_contained(Info.dependencies, File.AST->getMainFileName()))
+            Info.dependencies.push_back(File.AST->getMainFileName().str());
+        for (std::string& Dependency : Info.dependencies)
+            File.Stamps.emplace_back(Dependency, modificationTime(Dependency));
+    }
+
+    std::unique_ptr<ASTUnit> load(StringRef Path, std::string& Error)
+    {
+        std::vector<CompileCommand> Commands = Compilations.getCompileCommands(Path);
+        if (Commands.empty()) {
+            Error = "no compile command for " + Path.str();
+            return nullptr;
+        }
+        const CompileCommand& Command = Commands.front();
+        CommandLineArguments Args = getClangSyntaxOnlyAdjuster()(Command.CommandLine, Path);
+        Args = getClangStripOutputAdjuster()(Args, Path);
+        std::vector<const char*> Argv;
+        for (const std::string& Arg : Args)
+            Argv.push_back(Arg.c_str());
+
+        IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS = llvm::vfs::createPhysicalFileSystem();
+        FS->setCurrentWorkingDirectory(Command.Directory);
+        IntrusiveRefCntPtr<DiagnosticsEngine> Diags =
+            CompilerInstance::createDiagnostics(new DiagnosticOptions());
+
+        // The preamble is built by the first parse; user files are volatile
+        // so that edits are read in full on every reparse.
+        std::unique_ptr<ASTUnit> AST(ASTUnit::LoadFromCommandLine(
+            Argv.data(), Argv.data() + Argv.size(), PCHOperations, Diags, ResourceDir,
+            /*OnlyLocalDecls=*/true, CaptureDiagsKind::None, /*RemappedFiles=*/llvm::None,
+            /*RemappedFilesKeepOriginalName=*/true, /*PrecompilePreambleAfterNParses=*/1,
+            TU_Complete, /*CacheCodeCompletionResults=*/false,
+            /*IncludeBriefCommentsInCodeCompletion=*/false, /*AllowPCHWithCompilerErrors=*/true,
+            SkipFunctionBodiesScope::None, /*SingleFileParse=*/false,
+            /*UserFilesAreVolatile=*/true, /*ForSerialization=*/false,
+            /*RetainExcludedConditionalBlocks=*/false, /*ModuleFormat=*/llvm::None,
+            /*ErrAST=*/nullptr, FS));
+        if (!AST)
+            Error = "failed to parse " + Path.str();
+        return AST;
+    }
+
+    void evictLeastRecentlyUsed()
+    {
+        while (Files.size() > std::max(1u, unsigned(MaxFiles))) {
+            auto Oldest = Files.begin();
+            for (auto It = Files.begin(); It != Files.end(); ++It)
+                if (It->second.LastUse < Oldest->second.LastUse)
+                    Oldest = It;
+            Files.erase(Oldest);
+        }
+    }
+
+    bool refresh(WatchedFile& File)
+    {
+        if (isStale(File)) {
+            File.Failed = File.AST->Reparse(PCHOperations);
+            if (File.Failed) {
+                // Not retried until the files change again.
+                for (auto& Stamp : File.Stamps)
+                    Stamp.second = modificationTime(Stamp.first);
+            }
+            else {
+                analyse(File);
+            }
+        }
+        return !File.Failed;
+    }
+
+public:
+    AnalysisServer(const CompilationDatabase& Compilations, const CheckerOptions& Opts,
+                   std::string ResourceDir)
+        : Compilations(Compilations), Opts(Opts), ResourceDir(std::move(ResourceDir)) {}
+
+    // Report of the file, parsed on the first request and refreshed if it
+    // changed since the last analysis.
+    std::string request(StringRef Path)
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        auto It = Files.find(Path);
+        if (It == Files.end()) {
+            std::string Error;
+            std::unique_ptr<ASTUnit> AST = load(Path, Error);
+            if (!AST)
+                return "error: " + Error + "\n";
+            It = Files.try_emplace(Path).first;
+            It->second.AST = std::move(AST);
+            analyse(It->second);
+        }
+        else if (!refresh(It->second)) {
+            return "error: failed to reparse " + Path.str() + "\n";
+        }
+        It->second.LastUse = ++Clock;
+        std::string Report = It->second.Report;
+        evictLeastRecentlyUsed();
+        return Report;
+    }
+
+    // Called by the watcher: reports are ready before the next request.
+    void poll()
+    {
+        std::lock_guard<std::mutex> Lock(Mutex);
+        for (auto& Entry : Files)
+            if (isStale(Entry.second) && !refresh(Entry.second))
+                llvm::errs() << "singleton-checkerd: failed to reparse " << Entry.first() << "\n";
+    }
+};
+
+int listenOn(StringRef Path)
+{
+    sockaddr_un Address{};
+    Address.sun_family = AF_UNIX;
+    if (Path.size() >= sizeof(Address.sun_path))
+        return -1;
+    std::memcpy(Address.sun_path, Path.data(), Path.size());
+
+    int Socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (Socket < 0)
+        return -1;
+    ::unlink(Address.sun_path);
+    if (bind(Socket, reinterpret_cast<sockaddr*>(&Address), sizeof(Address)) < 0
+        || listen(Socket, 16) < 0) {
+        close(Socket);
+        return -1;
+    }
+    return Socket;
+}
+
+// One request per connection: a path (or "!shutdown") terminated by a
+// newline, answered with the report; the server closes the connection.
+// A client silent for RequestTimeoutMs gets an empty request.
+std::string readRequest(int Connection)
+{
+    timeval Timeout{};
+    Timeout.tv_sec = RequestTimeoutMs / 1000;
+    Timeout.tv_usec = (RequestTimeoutMs % 1000) * 1000;
+    setsockopt(Connection, SOL_SOCKET, SO_RCVTIMEO, &Timeout, sizeof(Timeout));
+
+    std::string Request;
+    char Buffer[4096];
+    while (Request.find('\n') == std::string::npos) {
+        ssize_t Size = recv(Connection, Buffer, sizeof(Buffer), 0);
+        if (Size < 0 && errno == EINTR) continue;
+        if (Size <= 0) return std::string();
+        Request.append(Buffer, Size);
+    }
+    return Request.substr(0, Request.find('\n'));
+}
+
+// A client gone before its report arrives must not raise SIGPIPE.
+void writeAll(int Connection, StringRef Data)
+{
+    while (!Data.empty()) {
+        ssize_t Written = send(Connection, Data.data(), Data.size(), MSG_NOSIGNAL);
+        if (Written < 0 && errno == EINTR) continue;
+        if (Written <= 0) return;
+        Data = Data.drop_front(Written);
+    }
+}
+
+// Address inside the executable, used to locate the resource directory.
+int StaticSymbol;
+
+} // namespace
+
+int main(int argc, const char **argv)
+{
+    auto ExpectedParser = CommonOptionsParser::create(argc, argv, ServerCategory,
+                                                      llvm::cl::ZeroOrMore);
+    if (!ExpectedParser) {
+        llvm::errs() << llvm::toString(ExpectedParser.takeError());
+        return 1;
+    }
+
+    // Only main file declarations are re-analysed, headers live in the preamble.
+    CheckerOptions Opts;
+    Opts.scope = CheckerOptions::MainFileOnly;
+    Opts.format = Format;
+
+    AnalysisServer Server(ExpectedParser->getCompilations(), Opts,
+                          CompilerInvocation::GetResourcesPath(argv[0], &StaticSymbol));
+
+    int Socket = listenOn(SocketPath);
+    if (Socket < 0) {
+        llvm::errs() << "singleton-checkerd: cannot listen on " << SocketPath << ": "
+                     << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    std::atomic<bool> Stop{false};
+    std::thread Watcher([&] {
+        while (!Stop) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(PollIntervalMs));
+            Server.poll();
+        }
+    });
+
+    while (!Stop) {
+        int Connection = accept(Socket, nullptr, nullptr);
+        if (Connection < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        std::string Request = readRequest(Connection);
+        if (Request.empty()) {
+            // Timed out, disconnected or sent an empty line.
+        }
+        else if (Request == "!shutdown") {
+            Stop = true;
+            writeAll(Connection, "shutting down\n");
+        }
+        else {
+            writeAll(Connection, Server.request(Request));
+        }
+        close(Connection);
+    }
+
+    Stop = true;
+    Watcher.join();
+    close(Socket);
+    ::unlink(SocketPath.c_str());
+    return 0;
+}
@@ -0,0 +1,426 @@
+#include "SingletonChecker.h"
+#include "ResultCache.h"
+#include "Sharding.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Frontend/ASTUnit.h"
+#include "clang/Tooling/CommonOptionsParser.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Threading.h"
+#include "llvm/Support/VirtualFileSystem.h"
+
+#include <algorithm>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <numeric>
+
+using namespace clang::tooling;
+using namespace SingletonChecker;
+
+static llvm::cl::OptionCategory CheckerCategory("singleton-checker options");
+
+static llvm::cl::opt<unsigned> Jobs(
+    "j",
+    llvm::cl::desc("Number of worker threads (0 = one per core)"),
+    llvm::cl::init(0),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<CheckerOptions::AnalysisScope> Scope(
+    "scope",
+    llvm::cl::desc("Declarations to analyse"),
+    llvm::cl::values(
+        clEnumValN(CheckerOptions::MainFileOnly, "main", "Main file only"),
+        clEnumValN(CheckerOptions::ProjectHeaders, "project", "Main file and non-system headers"),
+        clEnumValN(CheckerOptions::Everything, "all", "Everything, system headers included")),
+    llvm::cl::init(CheckerOptions::MainFileOnly),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> ProjectRoot(
+    "project-root",
+    llvm::cl::desc("With -scope=project, analyse only headers under this directory"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<OutputFormat> Format(
+    "format",
+    llvm::cl::desc("Report format"),
+    llvm::cl::values(
+        clEnumValN(OutputFormat::Text, "text", "Human readable report"),
+        clEnumValN(OutputFormat::JSONLines, "jsonl", "One JSON object per detection"),
+        clEnumValN(OutputFormat::SARIF, "sarif", "SARIF 2.1.0 log")),
+    llvm::cl::init(OutputFormat::Text),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<unsigned> NodeBudget(
+    "node-budget",
+    llvm::cl::desc("Give up function bodies costing more than this many statements (0 = unlimited)"),
+    llvm::cl::init(0),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<AnalysisEngine> Engine(
+    "engine",
+    llvm::cl::desc("getInstance detection engine"),
+    llvm::cl::values(
+        clEnumValN(AnalysisEngine::Visitor, "visitor", "Walk every candidate body"),
+        clEnumValN(AnalysisEngine::Matchers, "matchers", "All patterns in one MatchFinder pass"),
+        clEnumValN(AnalysisEngine::CFG, "cfg", "Flow-sensitive walk of the CFG of every candidate body")),
+    llvm::cl::init(AnalysisEngine::Visitor),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<bool> StartupAudit(
+    "startup-audit",
+    llvm::cl::desc("Report the static singleton instances initialized before main"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> InstanceSummaryDir(
+    "instance-summary-dir",
+    llvm::cl::desc("Write per-TU summaries of static objects for singleton-instances"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> DetectionIndexDir(
+    "detection-index-dir",
+    llvm::cl::desc("Write per-TU indexes of the reported classes for singleton-query"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<bool> FromAST(
+    "from-ast",
+    llvm::cl::desc("Inputs are AST files (-emit-ast, PCH), loaded lazily instead of parsing sources"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<bool> PrintASTStats(
+    "print-ast-stats",
+    llvm::cl::desc("With -from-ast, print how much of each AST file was deserialized"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> CacheDir(
+    "cache-dir",
+    llvm::cl::desc("Reuse reports of unchanged TUs from this directory"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<unsigned> CacheSizeMB(
+    "cache-size-mb",
+    llvm::cl::desc("Size limit of the result cache, least recently used entries are evicted"),
+    llvm::cl::init(512),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> RegistryDir(
+    "registry-dir",
+    llvm::cl::desc("Share the set of analysed header declarations with other processes"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> RegistryRun(
+    "registry-run",
+    llvm::cl::desc("Build run of the -registry-dir claims, the same for every process of "
+                   "one run (default: a new run per process)"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> Shard(
+    "shard",
+    llvm::cl::desc("Analyse only shard <index>/<count> (index from 0) of the files, "
+                   "balanced by the -timings history"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> ShardOutput(
+    "shard-output",
+    llvm::cl::desc("Write the records of the shard to this file for singleton-merge "
+                   "instead of printing the report"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> TimingsFile(
+    "timings",
+    llvm::cl::desc("Per-TU analysis times of previous runs, used to balance shards "
+                   "and to start the longest TUs first"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::opt<std::string> RecordTimings(
+    "record-timings",
+    llvm::cl::desc("Update this file with the analysis time of every analysed TU"),
+    llvm::cl::cat(CheckerCategory));
+
+static llvm::cl::extrahelp CommonHelp(CommonOptionsParser::HelpMessage);
+static llvm::cl::extrahelp MoreHelp(
+    "\nWithout explicit source paths every file of the compilation database is analysed.\n"
+    "Reports are printed in file path order, independently of the number of threads.\n"
+    "With -from-ast the source paths are AST files and no compilation database is\n"
+    "needed: singleton-checker -from-ast a.ast b.pch --\n"
+    "Shards of a distributed run are combined with singleton-merge.\n");
+
+namespace {
+
+class CheckerActionFactory : public FrontendActionFactory {
+    llvm::raw_ostream& OS;
+    const CheckerOptions& Opts;
+    TranslationUnitInfo* Info;
+    AnalyzedRegistry* Registry;
+
+public:
+    CheckerActionFactory(llvm::raw_ostream& OS, const CheckerOptions& Opts, 
+                         TranslationUnitInfo* Info, AnalyzedRegistry* Registry) 
+        : OS(OS), Opts(Opts), Info(Info), Registry(Registry) {}
+
+    std::unique_ptr<FrontendAction> create() override {
+        return std::make_unique<ClassVisitorPlugin>(OS, Opts, Info, Registry);
+    }
+};
+
+std::string cacheKey(const CompilationDatabase& Compilations, StringRef File, 
+                     const CheckerOptions& Opts)
+{
+    std::string Directories;
+    std::vector<std::string> Arguments;
+    for (const CompileCommand& Command : Compilations.getCompileCommands(File)) {
+        Directories += Command.Directory + ";";
+        Arguments.insert(Arguments.end(), Command.CommandLine.begin(), Command.CommandLine.end());
+        Arguments.emplace_back();
+    }
+    return ResultCache::makeKey(File, Directories, Arguments, Opts.fingerprint());
+}
+
+// Loads an AST file without reparsing; declarations are deserialized only
+// when the analysis reaches them. The report depends on the file alone.
+bool runOnASTFile(StringRef File, llvm::raw_ostream& OS, const CheckerOptions& Opts,
+                  TranslationUnitInfo& Info, AnalyzedRegistry* Registry)
+{
+    IntrusiveRefCntPtr<DiagnosticsEngine> Diags =
+        CompilerInstance::createDiagnostics(new DiagnosticOptions());
+    PCHContainerOperations PCHOperations;
+    std::unique_ptr<ASTUnit> AST = ASTUnit::LoadFromASTFile(
+        File.str(), PCHOperations.getRawReader(), ASTUnit::LoadASTOnly, Diags, 
+        FileSystemOptions(), /*UseDebugInfo=*/false, /*OnlyLocalDecls=*/true);
+    if (!AST)
+        return false;
+
+    ClassVisitorASTConsumer Consumer(&AST->getASTContext(), OS, Opts, &Info, Registry);
+    Consumer.HandleSerializedAST(*AST);
+
+    llvm::SmallString<256> Path(File);
+    llvm::sys::fs::make_absolute(Path);
+    Info.dependencies = {std::string(Path.str())};
+
+    if (PrintASTStats)
+        AST->getASTContext().getExternalSource()->PrintStats();
+    return true;
+}
+
+// A cached TU is not parsed, its instance summary and detection index are
+// written from the entry so that singleton-instances and singleton-query
+// see every TU of the run.
+void replaySideOutputs(const ResultCache::Entry& Entry, const CheckerOptions& Opts)
+{
+    if (Entry.mainFile.empty())
+        return;
+    if (!Opts.instanceSummaryDir.empty()
+        && !InstanceSummary::writeFile(Opts.instanceSummaryDir, Entry.mainFile, Entry.instanceSummary))
+        llvm::errs() << "singleton-checker: cannot write the instance summary to " << Opts.instanceSummaryDir << "\n";
+    if (!Opts.detectionIndexDir.empty()
+        && !DetectionIndexBuilder::writeFile(Opts.detectionIndexDir, Entry.mainFile, Entry.detectionIndex))
+        llvm::errs() << "singleton-checker: cannot write the detection index to " << Opts.detectionIndexDir << "\n";
+}
+
+} // namespace
+
+int main(int argc, const char **argv)
+{
+    auto ExpectedParser = CommonOptionsParser::create(argc, argv, CheckerCategory,
+                                                      llvm::cl::ZeroOrMore);
+    if (!ExpectedParser) {
+        llvm::errs() << llvm::toString(ExpectedParser.takeError());
+        return 1;
+    }
+    CommonOptionsParser& OptionsParser = ExpectedParser.get();
+    const CompilationDatabase& Compilations = OptionsParser.getCompilations();
+
+    CheckerOptions Opts;
+    Opts.scope = Scope;
+    Opts.setProjectRoot(ProjectRoot);
+    Opts.format = Format;
+    Opts.nodeBudget = NodeBudget;
+    Opts.engine = Engine;
+    Opts.instanceSummaryDir = InstanceSummaryDir;
+    Opts.detectionIndexDir = DetectionIndexDir;
+    Opts.startupAudit = StartupAudit;
+
+    std::vector<std::string> Files = OptionsParser.getSourcePathList();
+    if (Files.empty() && !FromAST)
+        Files = Compilations.getAllFiles();
+
+    // Fixed order of TUs makes the merged report independent of scheduling.
+    llvm::sort(Files);
+    Files.erase(std::unique(Files.begin(), Files.end()), Files.end());
+
+    TimingTable Timings;
+    if (!TimingsFile.empty() && !Timings.read(TimingsFile)) {
+        llvm::errs() << "singleton-checker: cannot read timings " << TimingsFile << "\n";
+        return 1;
+    }
+
+    // Every shard process computes the same plan and keeps its own files.
+    if (!Shard.empty()) {
+        llvm::Optional<ShardSpec> Spec = ShardSpec::parse(Shard);
+        if (!Spec) {
+            llvm::errs() << "singleton-checker: invalid shard '" << Shard << "', expected <index>/<count>\n";
+            return 1;
+        }
+        std::vector<unsigned> Plan = planShards(Files, Timings.costsOf(Files), Spec->count);
+        std::vector<std::string> Mine;
+        for (size_t I = 0; I < Files.size(); ++I)
+            if (Plan[I] == Spec->index)
+                Mine.push_back(std::move(Files[I]));
+        Files = std::move(Mine);
+    }
+
+    // Most expensive TUs are queued first, a long one started last would
+    // keep the run going after all the others are done.
+    std::vector<size_t> Order(Files.size());
+    std::iota(Order.begin(), Order.end(), 0);
+    if (!Timings.empty()) {
+        std::vector<double> Costs = Timings.costsOf(Files);
+        llvm::stable_sort(Order, [&](size_t L, size_t R) { return Costs[L] > Costs[R]; });
+    }
+
+    std::unique_ptr<ResultCache> Cache;
+    if (!CacheDir.empty())
+        Cache = std::make_unique<ResultCache>(CacheDir, uint64_t(CacheSizeMB) << 20);
+
+    // Header declarations are analysed by the first TU reaching them, also
+    // with the cache: their reports are cached per USR, and a TU entry is a
+    // hit only once the reports of all its header declarations are there.
+    // Duplicates of a report (a hit and a miss both have it) are dropped
+    // by USR below.
+    std::string Run = RegistryRun;
+    if (Run.empty())
+        Run = std::to_string(llvm::sys::Process::getProcessId()) + "-"
+            + std::to_string(std::chrono::system_clock::now().time_since_epoch().count());
+    AnalyzedRegistry Registry(RegistryDir, Run);
+    AnalyzedRegistry* SharedRegistry = &Registry;
+    const std::string Options = Opts.fingerprint();
+
+    std::vector<std::string> Reports(Files.size());
+    std::vector<std::vector<std::pair<std::string, std::string>>> HeaderReports(Files.size());
+    std::vector<double> Milliseconds(Files.size(), -1);
+    std::atomic<unsigned> Failures{0};
+    std::mutex ErrorsMutex;
+
+    {
+        // Every TU is an independent task, idle workers pick up the next
+        // one from the shared queue, so long TUs do not block the rest.
+        llvm::ThreadPool Pool(llvm::hardware_concurrency(Jobs));
+        for (size_t I : Order) {
+            Pool.async([&, I] {
+                std::string Key;
+                if (Cache) {
+                    Key = FromAST ? ResultCache::makeKey(Files[I], "", {}, Options + ";ast")
+                                  : cacheKey(Compilations, Files[I], Opts);
+                    if (llvm::Optional<ResultCache::Entry> Cached = Cache->lookup(Key, Options)) {
+                        Reports[I] = std::move(Cached->report);
+                        HeaderReports[I] = std::move(Cached->headerReports);
+                        replaySideOutputs(*Cached, Opts);
+                        return;
+                    }
+                }
+
+                auto Start = std::chrono::steady_clock::now();
+                llvm::raw_string_ostream OS(Reports[I]);
+                TranslationUnitInfo Info;
+                bool Failed;
+                if (FromAST) {
+                    Failed = !runOnASTFile(Files[I], OS, Opts, Info, SharedRegistry);
+                }
+                else {
+                    // Each worker gets its own VFS so that concurrent TUs may
+                    // use different working directories.
+                    IntrusiveRefCntPtr<llvm::vfs::FileSystem> FS =
+                        llvm::vfs::createPhysicalFileSystem();
+                    ClangTool Tool(Compilations, Files[I],
+                                   std::make_shared<PCHContainerOperations>(), FS);
+                    CheckerActionFactory Factory(OS, Opts, &Info, SharedRegistry);
+                    Failed = Tool.run(&Factory) != 0;
+                }
+                if (Failed) {
+                    ++Failures;
+                    std::lock_guard<std::mutex> Lock(ErrorsMutex);
+                    llvm::errs() << "singleton-checker: failed to analyse " << Files[I] << "\n";
+                    return;
+                }
+                OS.flush();
+                Milliseconds[I] = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - Start).count();
+
+                if (Cache) {
+                    llvm::StringMap<std::string> Claimed;
+                    for (const std::string& USR : Info.claimedHeaderUSRs)
+                        Claimed[USR];
+                    for (const auto& HeaderReport : Info.headerReports)
+                        Claimed[HeaderReport.first] += HeaderReport.second;
+                    for (const auto& HeaderReport : Claimed)
+                        Cache->storeHeader(HeaderReport.first(), Options, Info.dependencies,
+                                           HeaderReport.second);
+                    llvm::sort(Info.headerUSRs);
+                    Info.headerUSRs.erase(std::unique(Info.headerUSRs.begin(), Info.headerUSRs.end()),
+                                          Info.headerUSRs.end());
+                    Cache->store(Key, Info.dependencies, {Reports[I], std::move(Info.headerUSRs), {},
+                                                          Info.mainFile, Info.instanceSummary,
+                                                          Info.detectionIndex});
+                }
+                HeaderReports[I] = std::move(Info.headerReports);
+            });
+        }
+        Pool.wait();
+    }
+
+    if (!RecordTimings.empty()) {
+        TimingTable Recorded;
+        Recorded.read(RecordTimings);
+        for (size_t I = 0; I < Files.size(); ++I)
+            if (Milliseconds[I] >= 0)
+                Recorded.set(Files[I], Milliseconds[I]);
+        if (!Recorded.write(RecordTimings))
+            llvm::errs() << "singleton-checker: cannot write timings " << RecordTimings << "\n";
+    }
+
+    if (!ShardOutput.empty()) {
+        ShardResult Result;
+        Result.format = outputFormatName(Opts.format).str();
+        Result.failures = Failures;
+        for (size_t I = 0; I < Files.size(); ++I)
+            Result.files.push_back({Files[I], std::move(Reports[I]), Milliseconds[I]});
+        for (auto& TUHeaderReports : HeaderReports)
+            for (auto& HeaderReport : TUHeaderReports)
+                Result.headerReports.push_back(std::move(HeaderReport));
+        if (!Result.write(ShardOutput)) {
+            llvm::errs() << "singleton-checker: cannot write " << ShardOutput << "\n";
+            return 1;
+        }
+    }
+    else {
+        std::string Records;
+        for (const std::string& Report : Reports)
+            Records += Report;
+
+        // Ordered by USR, whichever TU happened to analyse the declaration.
+        std::map<std::string, std::string> HeaderReportsByUSR;
+        for (auto& TUHeaderReports : HeaderReports)
+            for (auto& HeaderReport : TUHeaderReports)
+                HeaderReportsByUSR.insert(std::move(HeaderReport));
+        for (const auto& HeaderReport : HeaderReportsByUSR)
+            Records += HeaderReport.second;
+
+        ReportWriter::create(Opts.format)->writeDocument(llvm::outs(), Records);
+    }
+
+    // Nobody else knows a run made up here, its markers are of no use.
+    if (RegistryRun.empty())
+        Registry.removeRun();
+
+    if (Cache) {
+        Cache->prune();
+        llvm::errs() << "singleton-checker: result cache hits " << Cache->getHits() 
+                     << ", misses " << Cache->getMisses() << "\n";
+    }
+
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,82 @@
+#include "InstanceSummary.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace SingletonChecker;
+
+static llvm::cl::OptionCategory InstancesCategory("singleton-instances options");
+
+static llvm::cl::list<std::string> Inputs(
+    llvm::cl::Positional,
+    llvm::cl::desc("<summary directory or .sum file>..."),
+    llvm::cl::OneOrMore,
+    llvm::cl::cat(InstancesCategory));
+
+static llvm::cl::opt<unsigned> MinInstances(
+    "min-instances",
+    llvm::cl::desc("Report records with at least this many distinct objects"),
+    llvm::cl::init(2),
+    llvm::cl::cat(InstancesCategory));
+
+static llvm::cl::opt<bool> JSONLines(
+    "jsonl",
+    llvm::cl::desc("One JSON object per record instead of text"),
+    llvm::cl::cat(InstancesCategory));
+
+int main(int argc, const char **argv)
+{
+    llvm::cl::HideUnrelatedOptions(InstancesCategory);
+    llvm::cl::ParseCommandLineOptions(argc, argv,
+        "Merges the per-TU instance summaries written with -instance-summary-dir and\n"
+        "lists records with several objects of static storage duration program wide.\n");
+
+    InstanceIndex Index;
+    for (const std::string& Input : Inputs) {
+        if (llvm::sys::fs::is_directory(Input)) {
+            std::error_code EC;
+            Index.addDirectory(Input, EC);
+            if (EC) {
+                llvm::errs() << "singleton-instances: " << Input << ": " << EC.message() << "\n";
+                return 1;
+            }
+        }
+        else if (!Index.addFile(Input)) {
+            llvm::errs() << "singleton-instances: cannot read " << Input << "\n";
+            return 1;
+        }
+    }
+
+    auto Records = Index.recordsWithInstances(MinInstances);
+    for (const auto* Entry : Records) {
+        const InstanceIndex::RecordInstances& Record = Entry->second;
+        if (JSONLines) {
+            llvm::json::OStream J(llvm::outs());
+            J.object([&] {
+                J.attribute("kind", "instances");
+                J.attribute("name", Record.name);
+                J.attribute("usr", Entry->first());
+                J.attributeArray("instances", [&] {
+                    for (const InstanceIndex::InstanceRef& Instance : Record.instances)
+                        J.object([&] {
+                            J.attribute("usr", Instance.usr);
+                            J.attribute("location", Instance.location);
+                        });
+                });
+            });
+            llvm::outs() << "\n";
+            continue;
+        }
+        llvm::outs() << Record.name << ": " << Record.instances.size() << " instances\n";
+        for (const InstanceIndex::InstanceRef& Instance : Record.instances)
+            llvm::outs() << "    " << Instance.location << "\n";
+    }
+
+    llvm::errs() << "singleton-instances: " << Index.getSummaries() << " summaries, "
+                 << Index.getRecords() << " records, " << Records.size() << " with "
+                 << MinInstances << "+ instances";
+    if (Index.getMalformed())
+        llvm::errs() << ", " << Index.getMalformed() << " malformed summaries";
+    llvm::errs() << "\n";
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "ReportWriter.h"
+#include "Sharding.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+
+using namespace SingletonChecker;
+
+static llvm::cl::OptionCategory MergeCategory("singleton-merge options");
+
+static llvm::cl::list<std::string> Inputs(
+    llvm::cl::Positional,
+    llvm::cl::desc("<shard result>..."),
+    llvm::cl::OneOrMore,
+    llvm::cl::cat(MergeCategory));
+
+static llvm::cl::opt<std::string> RecordTimings(
+    "record-timings",
+    llvm::cl::desc("Update this file with the analysis times measured by the shards, "
+                   "the -timings of the next run"),
+    llvm::cl::cat(MergeCategory));
+
+int main(int argc, const char **argv)
+{
+    llvm::cl::HideUnrelatedOptions(MergeCategory);
+    llvm::cl::ParseCommandLineOptions(argc, argv,
+        "Combines the -shard-output files of a sharded singleton-checker run into the\n"
+        "report a single run would print: TUs in path order, then each header\n"
+        "declaration once, in USR order.\n");
+
+    llvm::Optional<OutputFormat> Format;
+    std::map<std::string, ShardResult::FileReport> Files;
+    std::map<std::string, std::string> HeaderReportsByUSR;
+    unsigned Failures = 0;
+    for (const std::string& Input : Inputs) {
+        llvm::Expected<ShardResult> Result = ShardResult::read(Input);
+        if (!Result) {
+            llvm::errs() << "singleton-merge: " << Input << ": " << llvm::toString(Result.takeError()) << "\n";
+            return 1;
+        }
+        llvm::Optional<OutputFormat> ShardFormat = parseOutputFormat(Result->format);
+        if (!ShardFormat || (Format && *Format != *ShardFormat)) {
+            llvm::errs() << "singleton-merge: " << Input << ": format '" << Result->format
+                         << "' differs from the other shards\n";
+            return 1;
+        }
+        Format = ShardFormat;
+        Failures += Result->failures;
+        for (ShardResult::FileReport& File : Result->files)
+            Files.emplace(File.path, std::move(File));
+        for (auto& HeaderReport : Result->headerReports)
+            HeaderReportsByUSR.insert(std::move(HeaderReport));
+    }
+
+    std::string Records;
+    for (const auto& File : Files)
+        Records += File.second.report;
+    for (const auto& HeaderReport : HeaderReportsByUSR)
+        Records += HeaderReport.second;
+    ReportWriter::create(*Format)->writeDocument(llvm::outs(), Records);
+
+    if (!RecordTimings.empty()) {
+        TimingTable Timings;
+        Timings.read(RecordTimings);
+        for (const auto& File : Files)
+            if (File.second.milliseconds >= 0)
+                Timings.set(File.first, File.second.milliseconds);
+        if (!Timings.write(RecordTimings)) {
+            llvm::errs() << "singleton-merge: cannot write timings " << RecordTimings << "\n";
+            return 1;
+        }
+    }
+
+    llvm::errs() << "singleton-merge: " << Inputs.size() << " shards, " << Files.size() << " files, "
+                 << HeaderReportsByUSR.size() << " header declarations";
+    if (Failures)
+        llvm::errs() << ", " << Failures << " failed TUs";
+    llvm::errs() << "\n";
+    return Failures ? 1 : 0;
+}
@@ -0,0 +1,232 @@
+#include "AnalysisKinds.h"
+#include "DetectionIndex.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/JSON.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace SingletonChecker;
+
+static llvm::cl::OptionCategory QueryCategory("singleton-query options");
+
+static llvm::cl::list<std::string> Inputs(
+    llvm::cl::Positional,
+    llvm::cl::desc("<index directory or .idx file>..."),
+    llvm::cl::OneOrMore,
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::list<std::string> Patterns(
+    "pattern",
+    llvm::cl::desc("Classes detected with any of these patterns (naive, meyers, crtp, if-naive, "
+                   "flags-naive, unknown)"),
+    llvm::cl::CommaSeparated,
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::opt<std::string> Under(
+    "under",
+    llvm::cl::desc("Classes declared in files under this directory"),
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::opt<bool> HiddenInstanceMethod(
+    "hidden-instance-method",
+    llvm::cl::desc("Classes whose getInstance is not public"),
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::opt<bool> Skipped(
+    "skipped",
+    llvm::cl::desc("Classes whose analysis exceeded the node budget"),
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::opt<std::string> Condition(
+    "condition",
+    llvm::cl::desc("Condition of getInstance (unary, compare-nullptr, compare-null, var, unknown)"),
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::opt<std::string> AccessCost(
+    "access-cost",
+    llvm::cl::desc("Access cost of getInstance (plain-load, static-guard, atomic-acquire, "
+                   "double-checked-locking, call-once, mutex-every-call, unknown)"),
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::opt<bool> CountOnly(
+    "count",
+    llvm::cl::desc("Only print the number of matching classes"),
+    llvm::cl::cat(QueryCategory));
+
+static llvm::cl::opt<bool> JSONLines(
+    "jsonl",
+    llvm::cl::desc("One JSON object per class instead of text"),
+    llvm::cl::cat(QueryCategory));
+
+namespace {
+
+// Position of a name among names, or -1.
+int indexOf(llvm::ArrayRef<const char*> names, llvm::StringRef name)
+{
+    for (size_t i = 0; i < names.size(); ++i)
+        if (name == names[i])
+            return i;
+    return -1;
+}
+
+// Enum value named text, or -1. The values run from 0 to last.
+template<typename Enum>
+int valueOf(llvm::StringRef (*name)(Enum), Enum last, llvm::StringRef text)
+{
+    for (int value = 0; value <= last; ++value)
+        if (name(Enum(value)) == text)
+            return value;
+    return -1;
+}
+
+// Name of an enum value read from an index.
+template<typename Enum>
+llvm::StringRef nameOf(llvm::StringRef (*name)(Enum), Enum last, unsigned value)
+{
+    return value <= unsigned(last) ? name(Enum(value)) : "unknown";
+}
+
+bool isUnder(llvm::StringRef file, llvm::StringRef dir)
+{
+    if (!file.consume_front(dir))
+        return false;
+    return file.empty() || dir.endswith("/") || file.startswith("/");
+}
+
+// Offsets are turned into line:column for the matches only, reading each
+// source file at most once. The file may have changed or be gone since
+// the index was written: the offset is printed then.
+class LineResolver
+{
+    llvm::StringMap<std::vector<uint32_t>> lineStarts;
+
+public:
+    std::string resolve(const DetectionIndex::Location& location)
+    {
+        auto inserted = lineStarts.try_emplace(location.file);
+        std::vector<uint32_t>& starts = inserted.first->second;
+        if (inserted.second) {
+            if (auto buffer = llvm::MemoryBuffer::getFile(location.file)) {
+                llvm::StringRef text = (*buffer)->getBuffer();
+                starts.push_back(0);
+                for (size_t i = 0; i < text.size(); ++i)
+                    if (text[i] == '\n')
+                        starts.push_back(i + 1);
+            }
+        }
+        if (starts.empty() || location.offset > starts.back() + (1u << 20))
+            return (location.file + "@" + llvm::Twine(location.offset)).str();
+        auto line = llvm::upper_bound(starts, location.offset) - 1;
+        return (location.file + ":" + llvm::Twine(line - starts.begin() + 1) + ":"
+                + llvm::Twine(location.offset - *line + 1)).str();
+    }
+};
+
+} // namespace
+
+int main(int argc, const char **argv)
+{
+    llvm::cl::HideUnrelatedOptions(QueryCategory);
+    llvm::cl::ParseCommandLineOptions(argc, argv,
+        "Queries the detection indexes written with -detection-index-dir (or the plugin\n"
+        "argument -detection-index=<dir>) without parsing any source. Filters combine.\n");
+
+    uint32_t PatternMask = 0;
+    for (const std::string& Pattern : Patterns) {
+        int Bit = indexOf(DetectionFormat::patternNames, Pattern);
+        if (Bit < 0) {
+            llvm::errs() << "singleton-query: unknown pattern '" << Pattern << "'\n";
+            return 1;
+        }
+        PatternMask |= 1u << Bit;
+    }
+    int ConditionCode = Condition.empty() ? -1 : valueOf(AnalysisKinds::conditionName, AnalysisKinds::UnknownCondition, Condition.getValue());
+    if (!Condition.empty() && ConditionCode < 0) {
+        llvm::errs() << "singleton-query: unknown condition '" << Condition << "'\n";
+        return 1;
+    }
+    int AccessCostCode = AccessCost.empty() ? -1 : valueOf(AnalysisKinds::accessCostName, AnalysisKinds::MutexEveryCall, AccessCost.getValue());
+    if (!AccessCost.empty() && AccessCostCode < 0) {
+        llvm::errs() << "singleton-query: unknown access cost '" << AccessCost << "'\n";
+        return 1;
+    }
+    // Index paths are absolute.
+    llvm::SmallString<256> UnderDir(Under);
+    if (!UnderDir.empty()) {
+        llvm::sys::fs::make_absolute(UnderDir);
+        llvm::sys::path::remove_dots(UnderDir, /*remove_dot_dot=*/true);
+    }
+
+    DetectionIndex Index;
+    for (const std::string& Input : Inputs) {
+        if (llvm::sys::fs::is_directory(Input)) {
+            std::error_code EC;
+            Index.addDirectory(Input, EC);
+            if (EC) {
+                llvm::errs() << "singleton-query: " << Input << ": " << EC.message() << "\n";
+                return 1;
+            }
+        }
+        else if (!Index.addFile(Input)) {
+            llvm::errs() << "singleton-query: cannot read " << Input << "\n";
+            return 1;
+        }
+    }
+
+    LineResolver Lines;
+    unsigned Matches = 0;
+    Index.forEach([&](const DetectionIndex::Detection& D) {
+        if ((PatternMask && !(D.patterns & PatternMask))
+            || (HiddenInstanceMethod && !(D.flags & DetectionFormat::HiddenInstanceMethod))
+            || (Skipped && !(D.flags & DetectionFormat::SkippedByBudget))
+            || (ConditionCode >= 0 && D.condition != ConditionCode)
+            || (AccessCostCode >= 0 && D.accessCost != AccessCostCode)
+            || (!UnderDir.empty() && !isUnder(D.classLocation.file, UnderDir)))
+            return true;
+        ++Matches;
+        if (CountOnly)
+            return true;
+
+        llvm::SmallVector<llvm::StringRef, 6> Names;
+        for (size_t Bit = 0; Bit < std::size(DetectionFormat::patternNames); ++Bit)
+            if (D.patterns & (1u << Bit))
+                Names.push_back(DetectionFormat::patternNames[Bit]);
+        auto Where = [&](const DetectionIndex::Location& L) {
+            return L.file.empty() ? std::string() : Lines.resolve(L);
+        };
+
+        if (JSONLines) {
+            llvm::json::OStream J(llvm::outs());
+            J.object([&] {
+                J.attribute("kind", "class");
+                J.attribute("name", D.name);
+                J.attribute("usr", D.usr);
+                J.attribute("location", Where(D.classLocation));
+                J.attributeArray("patterns", [&] {
+                    for (llvm::StringRef Name : Names) J.value(Name);
+                });
+                J.attribute("condition", nameOf(AnalysisKinds::conditionName, AnalysisKinds::UnknownCondition, D.condition));
+                J.attribute("accessCost", nameOf(AnalysisKinds::accessCostName, AnalysisKinds::MutexEveryCall, D.accessCost));
+                J.attribute("hiddenInstanceMethod", bool(D.flags & DetectionFormat::HiddenInstanceMethod));
+                if (D.flags & DetectionFormat::SkippedByBudget)
+                    J.attribute("skipped", "budget");
+                if (!D.getInstance.file.empty())
+                    J.attribute("getInstance", Where(D.getInstance));
+                if (!D.instanceField.file.empty())
+                    J.attribute("instanceField", Where(D.instanceField));
+            });
+            llvm::outs() << "\n";
+            return true;
+        }
+        llvm::outs() << D.name << " " << Where(D.classLocation) << " [" << llvm::join(Names, ", ") << "]\n";
+        return true;
+    });
+
+    if (CountOnly)
+        llvm::outs() << Matches << "\n";
+    llvm::errs() << "singleton-query: " << Index.getIndexes() << " indexes, " << Matches << " matching classes";
+    if (Index.getMalformed())
+        llvm::errs() << ", " << Index.getMalformed() << " malformed indexes";
+    llvm::errs() << "\n";
+    return 0;
+}
@@ -0,0 +1,66 @@
+#include <atomic>
+#include <mutex>
+
+// mutex-every-call
+class LockedSingleton {
+private:
+    static LockedSingleton* instance;
+    static std::mutex mutex;
+
+    LockedSingleton() {}
+    LockedSingleton(const LockedSingleton&) = delete;
+    LockedSingleton& operator=(const LockedSingleton&) = delete;
+
+public:
+    static LockedSingleton* getInstance() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!instance)
+            instance = new LockedSingleton();
+        return instance;
+    }
+};
+
+// double-checked-locking
+class CheckedSingleton {
+private:
+    static std::atomic<CheckedSingleton*> instance;
+    static std::mutex mutex;
+
+    CheckedSingleton() {}
+    CheckedSingleton(const CheckedSingleton&) = delete;
+    CheckedSingleton& operator=(const CheckedSingleton&) = delete;
+
+public:
+    static CheckedSingleton* getInstance() {
+        if (!instance.load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!instance.load(std::memory_order_relaxed))
+                instance.store(new CheckedSingleton(), std::memory_order_release);
+        }
+        return instance;
+    }
+};
+
+// call-once
+class OnceSingleton {
+private:
+    static OnceSingleton* instance;
+    static std::once_flag flag;
+
+    OnceSingleton() {}
+    OnceSingleton(const OnceSingleton&) = delete;
+    OnceSingleton& operator=(const OnceSingleton&) = delete;
+
+public:
+    static OnceSingleton* getInstance() {
+        std::call_once(flag, [] { instance = new OnceSingleton(); });
+        return instance;
+    }
+};
+
+LockedSingleton* LockedSingleton::instance = nullptr;
+std::mutex LockedSingleton::mutex;
+std::atomic<CheckedSingleton*> CheckedSingleton::instance{nullptr};
+std::mutex CheckedSingleton::mutex;
+OnceSingleton* OnceSingleton::instance = nullptr;
+std::once_flag OnceSingleton::flag;
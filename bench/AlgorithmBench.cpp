@@ -0,0 +1,290 @@
+// Microbenchmark of the AnalysisAlgorithm helpers run for every method of
+// every class. The ASTs are built in process from embedded snippets; each
+// primitive is called -iterations times over all its inputs and reported
+// in ns/op and allocations/op (operator new and, with glibc, malloc).
+//
+//   algorithm-bench [-iterations=10000] [-methods=32] [-filter=<substring>]
+//                   [-out=bench/results-algorithms.json]
+
+#include "../SingletonChecker.h"
+#include "clang/ASTMatchers/ASTMatchFinder.h"
+#include "clang/ASTMatchers/ASTMatchers.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/ErrorHandling.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::atomic<unsigned long> allocations{0};
+
+} // namespace
+
+// Every allocation of the process is counted, the benchmark reads the
+// difference around the timed loop. With glibc operator new is counted by
+// the malloc below. Built with -fno-exceptions, as LLVM: a failed
+// allocation aborts.
+void* operator new(size_t size)
+{
+#if !defined(__GLIBC__)
+    ++allocations;
+#endif
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    llvm::report_bad_alloc_error("algorithm-bench: out of memory");
+}
+void* operator new[](size_t size) { return operator new(size); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+#if !defined(__GLIBC__)
+    ++allocations;
+#endif
+    return std::malloc(size ? size : 1);
+}
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept { return operator new(size, tag); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+
+#if defined(__GLIBC__)
+// llvm::SmallVector and friends grow with malloc, not operator new.
+extern "C" void* __libc_malloc(size_t);
+extern "C" void* __libc_calloc(size_t, size_t);
+extern "C" void* __libc_realloc(void*, size_t);
+extern "C" void* malloc(size_t size) { ++allocations; return __libc_malloc(size); }
+extern "C" void* calloc(size_t count, size_t size) { ++allocations; return __libc_calloc(count, size); }
+extern "C" void* realloc(void* p, size_t size) { ++allocations; return __libc_realloc(p, size); }
+#endif
+
+namespace {
+
+using namespace clang;
+using namespace clang::ast_matchers;
+
+struct BenchOptions
+{
+    unsigned iterations = 10000;
+    unsigned methods = 32;
+    std::string filter;
+    std::string out;
+};
+
+bool parseArgs(int argc, char** argv, BenchOptions& opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](const char* prefix, std::string& out) {
+            size_t len = std::strlen(prefix);
+            if (arg.compare(0, len, prefix)) return false;
+            out = arg.substr(len);
+            return true;
+        };
+        std::string number;
+        if (value("-filter=", opts.filter) || value("-out=", opts.out))
+            continue;
+        if (value("-iterations=", number)) {
+            opts.iterations = static_cast<unsigned>(std::strtoul(number.c_str(), nullptr, 10));
+            continue;
+        }
+        if (value("-methods=", number)) {
+            opts.methods = static_cast<unsigned>(std::strtoul(number.c_str(), nullptr, 10));
+            continue;
+        }
+        std::cerr << "algorithm-bench: unknown argument '" << arg << "'\n";
+        return false;
+    }
+    if (!opts.iterations) opts.iterations = 1;
+    return true;
+}
+
+// Minimal std wrappers: the helpers only look at the names in namespace
+// std, so no system header is needed.
+const char* prelude = R"(
+namespace std {
+template<class T> struct unique_ptr {
+    T* p;
+    T* get() const { return p; }
+    T& operator*() const { return *p; }
+    T* operator->() const { return p; }
+    explicit operator bool() const { return p; }
+};
+template<class T> struct atomic {
+    T v;
+    T load(int order = 5) const { return v; }
+    operator T() const { return v; }
+};
+}
+)";
+
+// A singleton whose methods hold the usual statements: static and local
+// objects of the class, instance checks through raw, smart and atomic
+// pointers.
+std::string widgetSource(unsigned methods)
+{
+    std::ostringstream os;
+    os << prelude
+       << "class Widget {\n"
+       << "    Widget() {}\n"
+       << "    static Widget* raw;\n"
+       << "    static std::unique_ptr<Widget> owned;\n"
+       << "    static std::atomic<Widget*> shared;\n"
+       << "    static bool ready;\n"
+       << "    Widget* next;\n"
+       << "    int value;\n"
+       << "public:\n"
+       << "    Widget(const Widget&) = delete;\n"
+       << "    Widget& operator=(const Widget&) = delete;\n"
+       << "    static Widget& getInstance() { static Widget instance; return instance; }\n"
+       << "    static Widget* getRaw() { if (!raw) raw = new Widget(); return raw; }\n"
+       << "    static Widget* getOwned() { if (!owned) return nullptr; return owned.get(); }\n"
+       << "    static Widget* getShared() { Widget* w = shared.load(2); if (w == nullptr) return w; return shared; }\n";
+    for (unsigned i = 0; i < methods; ++i)
+        os << "    int method" << i << "(int a) { int b = a + " << i << "; Widget* w = next;"
+           << " if (w) b += w->value; static int calls; ++calls; return b * value; }\n";
+    os << "};\n"
+       << "Widget* Widget::raw = nullptr;\n"
+       << "std::unique_ptr<Widget> Widget::owned;\n"
+       << "std::atomic<Widget*> Widget::shared;\n"
+       << "bool Widget::ready = false;\n";
+    return os.str();
+}
+
+template<typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+struct Result
+{
+    std::string name;
+    unsigned long ops = 0;
+    double nsPerOp = 0;
+    double allocsPerOp = 0;
+};
+
+// One warm-up pass, then the timed iterations; run() covers all inputs
+// and returns their number.
+Result measure(const std::string& name, unsigned iterations, const std::function<size_t()>& run)
+{
+    size_t inputs = run();
+    unsigned long before = allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned i = 0; i < iterations; ++i)
+        inputs = run();
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    unsigned long allocated = allocations.load() - before;
+
+    Result result;
+    result.name = name;
+    result.ops = static_cast<unsigned long>(iterations) * (inputs ? inputs : 1);
+    result.nsPerOp = ns / result.ops;
+    result.allocsPerOp = static_cast<double>(allocated) / result.ops;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    BenchOptions opts;
+    if (!parseArgs(argc, argv, opts))
+        return 1;
+
+    std::unique_ptr<ASTUnit> unit = tooling::buildASTFromCodeWithArgs(
+        widgetSource(opts.methods), {"-std=c++17", "-fsyntax-only"}, "widget.cpp");
+    if (!unit || unit->getDiagnostics().hasErrorOccurred()) {
+        std::cerr << "algorithm-bench: the embedded snippet does not compile\n";
+        return 1;
+    }
+    ASTContext& context = unit->getASTContext();
+
+    auto records = match(cxxRecordDecl(hasName("Widget"), isDefinition()).bind("r"), context);
+    auto* widget = const_cast<CXXRecordDecl*>(records.front().getNodeAs<CXXRecordDecl>("r"));
+
+    std::vector<CXXMethodDecl*> methods(widget->method_begin(), widget->method_end());
+    std::vector<VarDecl*> vars;
+    for (Decl* decl : widget->decls())
+        if (auto* var = dyn_cast<VarDecl>(decl))
+            vars.push_back(var);
+    std::vector<DeclStmt*> declStmts;
+    for (const BoundNodes& nodes : match(findAll(declStmt().bind("d")), context))
+        declStmts.push_back(const_cast<DeclStmt*>(nodes.getNodeAs<DeclStmt>("d")));
+    // Conditions and operands getVarDeclFromExpr meets in getInstance bodies.
+    std::vector<Expr*> exprs;
+    for (const BoundNodes& nodes : match(
+             findAll(expr(hasAncestor(cxxMethodDecl(matchesName("::get[A-Z]")))).bind("e")), context))
+        exprs.push_back(const_cast<Expr*>(nodes.getNodeAs<Expr>("e")));
+
+    using namespace AnalysisAlgorithm;
+    std::vector<std::pair<std::string, std::function<size_t()>>> benchmarks = {
+        {"isClassObject", [&] {
+            for (VarDecl* var : vars) doNotOptimize(isClassObject(var, widget));
+            return vars.size();
+        }},
+        {"countClassStaticObject(method)", [&] {
+            for (CXXMethodDecl* method : methods) doNotOptimize(countClassStaticObject(widget, method));
+            return methods.size();
+        }},
+        {"countClassStaticObject(class)", [&] {
+            doNotOptimize(countClassStaticObject(widget, widget));
+            return size_t(1);
+        }},
+        {"findClassLocalObject(method)", [&] {
+            for (CXXMethodDecl* method : methods) doNotOptimize(findClassLocalObject(widget, method));
+            return methods.size();
+        }},
+        {"findClassLocalObject(class)", [&] {
+            doNotOptimize(findClassLocalObject(widget, widget));
+            return size_t(1);
+        }},
+        {"compareReturnTypeWithRecordType", [&] {
+            for (CXXMethodDecl* method : methods) doNotOptimize(compareReturnTypeWithRecordType(method, widget));
+            return methods.size();
+        }},
+        {"getVarDeclFromExpr", [&] {
+            for (Expr* expr : exprs) doNotOptimize(getVarDeclFromExpr(expr));
+            return exprs.size();
+        }},
+        {"count_if(dyn_cast)", [&] {
+            for (DeclStmt* stmt : declStmts)
+                doNotOptimize(AnalysisAlgorithm::count_if(stmt->decl_begin(), stmt->decl_end(),
+                                                          [](VarDecl* var) { return var->isStaticLocal(); }));
+            return declStmts.size();
+        }},
+    };
+
+    std::vector<Result> results;
+    for (const auto& benchmark : benchmarks)
+        if (benchmark.first.find(opts.filter) != std::string::npos)
+            results.push_back(measure(benchmark.first, opts.iterations, benchmark.second));
+
+    std::printf("%-34s %12s %10s %12s\n", "primitive", "ops", "ns/op", "allocs/op");
+    for (const Result& result : results)
+        std::printf("%-34s %12lu %10.2f %12.3f\n", result.name.c_str(), result.ops,
+                    result.nsPerOp, result.allocsPerOp);
+
+    if (!opts.out.empty()) {
+        std::ofstream out(opts.out);
+        out << "{\n"
+            << "  \"iterations\":" << opts.iterations << ",\n"
+            << "  \"methods\":" << opts.methods << ",\n"
+            << "  \"primitives\":[";
+        for (size_t i = 0; i < results.size(); ++i)
+            out << (i ? "," : "") << "\n    {\"name\":\"" << results[i].name << "\",\"ops\":" << results[i].ops
+                << ",\"ns_per_op\":" << results[i].nsPerOp << ",\"allocs_per_op\":" << results[i].allocsPerOp << "}";
+        out << "\n  ]\n}\n";
+    }
+    return 0;
+}
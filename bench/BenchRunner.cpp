@@ -0,0 +1,241 @@
+// Times every TU of a generated corpus twice: bare -fsyntax-only and
+// -fsyntax-only with the plugin, and writes wall time and peak RSS of both
+// to a JSON file. The best of -repeat runs is kept per TU (wall time is
+// the minimum, RSS the maximum over the runs).
+//
+//   bench-runner -corpus=bench/corpus -plugin=./SingletonChecker.so
+//                -out=bench/results.json [-cxx=clang++] [-repeat=3]
+//                [-plugin-arg=<arg>]... [-compare=<old.json> -max-regression=<percent>]
+//
+// With -compare the run fails when the wall time overhead of the plugin
+// grew by more than -max-regression percent against the old result.
+
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct RunnerOptions
+{
+    std::string corpus = "bench/corpus";
+    std::string plugin = "./SingletonChecker.so";
+    std::string out = "bench/results.json";
+    std::string cxx = "clang++";
+    std::vector<std::string> pluginArgs;
+    unsigned repeat = 3;
+    std::string compare;
+    double maxRegression = 10.0;
+};
+
+struct Measurement
+{
+    double wallSeconds = 0;
+    long peakRSSKB = 0;
+    bool ok = true;
+};
+
+// Runs the command, its peak RSS comes from wait4() of the child only.
+Measurement measure(const std::vector<std::string>& command)
+{
+    std::vector<char*> argv;
+    for (const std::string& arg : command)
+        argv.push_back(const_cast<char*>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    Measurement result;
+    auto start = std::chrono::steady_clock::now();
+    pid_t pid = fork();
+    if (pid == 0) {
+        // Reports of the plugin are not part of the measurement.
+        int devNull = open("/dev/null", O_WRONLY);
+        if (devNull >= 0) dup2(devNull, STDOUT_FILENO);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+    if (pid < 0) {
+        result.ok = false;
+        return result;
+    }
+
+    int status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) < 0) {
+        result.ok = false;
+        return result;
+    }
+    result.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.peakRSSKB = usage.ru_maxrss;
+    result.ok = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    return result;
+}
+
+Measurement best(const std::vector<std::string>& command, unsigned repeat)
+{
+    Measurement result;
+    for (unsigned i = 0; i < std::max(repeat, 1u); ++i) {
+        Measurement run = measure(command);
+        if (!run.ok) return run;
+        result.wallSeconds = i ? std::min(result.wallSeconds, run.wallSeconds) : run.wallSeconds;
+        result.peakRSSKB = std::max(result.peakRSSKB, run.peakRSSKB);
+    }
+    return result;
+}
+
+// Finds "key":<number> in a result file written by this tool.
+bool readNumber(const std::string& json, const std::string& key, double& value)
+{
+    size_t pos = json.find("\"" + key + "\":");
+    if (pos == std::string::npos) return false;
+    value = std::strtod(json.c_str() + pos + key.size() + 3, nullptr);
+    return true;
+}
+
+bool parseArgs(int argc, char** argv, RunnerOptions& opts)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&](const char* prefix, std::string& out) {
+            size_t len = std::strlen(prefix);
+            if (arg.compare(0, len, prefix)) return false;
+            out = arg.substr(len);
+            return true;
+        };
+        std::string number;
+        if (value("-corpus=", opts.corpus) || value("-plugin=", opts.plugin)
+            || value("-out=", opts.out) || value("-cxx=", opts.cxx)
+            || value("-compare=", opts.compare))
+            continue;
+        if (value("-plugin-arg=", number)) {
+            opts.pluginArgs.push_back(number);
+            continue;
+        }
+        if (value("-repeat=", number)) {
+            opts.repeat = static_cast<unsigned>(std::strtoul(number.c_str(), nullptr, 10));
+            continue;
+        }
+        if (value("-max-regression=", number)) {
+            opts.maxRegression = std::strtod(number.c_str(), nullptr);
+            continue;
+        }
+        std::cerr << "bench-runner: unknown argument '" << arg << "'\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    RunnerOptions opts;
+    if (!parseArgs(argc, argv, opts))
+        return 1;
+
+    std::vector<std::string> files;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(opts.corpus, ec))
+        if (entry.path().extension() == ".cpp")
+            files.push_back(entry.path().string());
+    if (ec || files.empty()) {
+        std::cerr << "bench-runner: no TUs in " << opts.corpus << ", run corpus-generator first\n";
+        return 1;
+    }
+    std::sort(files.begin(), files.end());
+
+    std::string corpusConfig = "null";
+    {
+        std::ifstream manifest(opts.corpus + "/corpus.json");
+        std::string content((std::istreambuf_iterator<char>(manifest)), std::istreambuf_iterator<char>());
+        if (!content.empty())
+            corpusConfig = content.substr(0, content.find_last_not_of('\n') + 1);
+    }
+
+    std::ostringstream perTU;
+    Measurement baselineTotal, pluginTotal;
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::vector<std::string> baselineCommand = {opts.cxx, "-fsyntax-only", files[i]};
+        std::vector<std::string> pluginCommand = {
+            opts.cxx, "-fsyntax-only", "-Xclang", "-load", "-Xclang", opts.plugin,
+            "-Xclang", "-plugin", "-Xclang", "class-visitor"};
+        for (const std::string& arg : opts.pluginArgs) {
+            pluginCommand.insert(pluginCommand.end(),
+                                 {"-Xclang", "-plugin-arg-class-visitor", "-Xclang", arg});
+        }
+        pluginCommand.push_back(files[i]);
+
+        Measurement baseline = best(baselineCommand, opts.repeat);
+        Measurement plugin = best(pluginCommand, opts.repeat);
+        if (!baseline.ok || !plugin.ok) {
+            std::cerr << "bench-runner: compilation of " << files[i] << " failed\n";
+            return 1;
+        }
+
+        baselineTotal.wallSeconds += baseline.wallSeconds;
+        pluginTotal.wallSeconds += plugin.wallSeconds;
+        baselineTotal.peakRSSKB = std::max(baselineTotal.peakRSSKB, baseline.peakRSSKB);
+        pluginTotal.peakRSSKB = std::max(pluginTotal.peakRSSKB, plugin.peakRSSKB);
+
+        perTU << (i ? ",\n" : "\n")
+              << "    {\"file\":\"" << files[i] << "\""
+              << ",\"baseline\":{\"wall_s\":" << baseline.wallSeconds
+              << ",\"peak_rss_kb\":" << baseline.peakRSSKB << "}"
+              << ",\"plugin\":{\"wall_s\":" << plugin.wallSeconds
+              << ",\"peak_rss_kb\":" << plugin.peakRSSKB << "}}";
+    }
+
+    double wallOverhead = baselineTotal.wallSeconds > 0
+        ? (pluginTotal.wallSeconds / baselineTotal.wallSeconds - 1.0) * 100.0 : 0.0;
+    double rssOverhead = baselineTotal.peakRSSKB > 0
+        ? (double(pluginTotal.peakRSSKB) / baselineTotal.peakRSSKB - 1.0) * 100.0 : 0.0;
+
+    std::ofstream out(opts.out);
+    out << "{\n"
+        << "  \"corpus\":" << corpusConfig << ",\n"
+        << "  \"repeat\":" << opts.repeat << ",\n"
+        << "  \"baseline\":{\"wall_s\":" << baselineTotal.wallSeconds
+        << ",\"peak_rss_kb\":" << baselineTotal.peakRSSKB << "},\n"
+        << "  \"plugin\":{\"wall_s\":" << pluginTotal.wallSeconds
+        << ",\"peak_rss_kb\":" << pluginTotal.peakRSSKB << "},\n"
+        << "  \"overhead_wall_percent\":" << wallOverhead << ",\n"
+        << "  \"overhead_rss_percent\":" << rssOverhead << ",\n"
+        << "  \"tus\":[" << perTU.str() << "\n  ]\n"
+        << "}\n";
+    if (!out) {
+        std::cerr << "bench-runner: cannot write " << opts.out << "\n";
+        return 1;
+    }
+
+    std::cerr << "bench-runner: " << files.size() << " TUs, plugin overhead "
+              << wallOverhead << "% wall, " << rssOverhead << "% peak RSS\n";
+
+    if (!opts.compare.empty()) {
+        std::ifstream old(opts.compare);
+        std::string content((std::istreambuf_iterator<char>(old)), std::istreambuf_iterator<char>());
+        double oldOverhead = 0;
+        if (!readNumber(content, "overhead_wall_percent", oldOverhead)) {
+            std::cerr << "bench-runner: no previous result in " << opts.compare << "\n";
+            return 1;
+        }
+        if (wallOverhead - oldOverhead > opts.maxRegression) {
+            std::cerr << "bench-runner: overhead regressed from " << oldOverhead << "% to "
+                      << wallOverhead << "%\n";
+            return 2;
+        }
+    }
+    return 0;
+}
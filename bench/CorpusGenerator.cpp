@@ -0,0 +1,263 @@
+// Generates a synthetic corpus of translation units for the scalability
+// benchmark. Every TU mixes the singleton shapes of the sample files
+// (naive, if-naive, flags, Meyers, CRTP, friend getInstance) with plain
+// classes, so both the detection paths and the rejection paths are timed.
+//
+//   corpus-generator -out=bench/corpus -tus=16 -classes=200 -methods=8
+//                    -friends=4 -stmts=32 -crtp=50 -seed=1
+//
+// The parameters are written to <out>/corpus.json for the bench runner.
+
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+
+namespace {
+
+struct CorpusOptions
+{
+    std::string out = "bench/corpus";
+    unsigned tus = 8;
+    unsigned classes = 100;     // per TU
+    unsigned methods = 6;       // per class
+    unsigned friends = 2;       // friend declarations per class
+    unsigned stmts = 16;        // statements per method body
+    unsigned crtp = 20;         // CRTP instantiations per TU
+    unsigned seed = 1;
+};
+
+enum class Shape { Plain, Naive, IfNaive, Flags, Meyers, FriendGetInstance, NumShapes };
+
+class CorpusGenerator
+{
+    const CorpusOptions& opts;
+    std::mt19937 rng;
+
+    unsigned pick(unsigned bound) { return bound ? rng() % bound : 0; }
+
+    // Straight-line code with nested control flow every few statements, so
+    // body scans see realistic depth and not only a flat list.
+    void writeBody(std::ostream& os, const std::string& indent, unsigned stmts)
+    {
+        os << indent << "int acc = " << pick(100) << ";\n";
+        for (unsigned i = 0; i < stmts; ++i) {
+            switch (pick(4)) {
+                case 0:
+                    os << indent << "acc += " << pick(1000) << " * value;\n";
+                    break;
+                case 1:
+                    os << indent << "if (acc > " << pick(1000) << ") { acc -= value; } else { acc ^= "
+                       << pick(64) << "; }\n";
+                    break;
+                case 2:
+                    os << indent << "for (int i = 0; i < " << 1 + pick(8) << "; ++i) { acc += i; }\n";
+                    break;
+                default:
+                    os << indent << "while (acc > " << 1000 + pick(1000) << ") { acc /= 2; }\n";
+                    break;
+            }
+        }
+        os << indent << "return acc;\n";
+    }
+
+    void writeMethods(std::ostream& os, unsigned methods)
+    {
+        for (unsigned m = 0; m < methods; ++m) {
+            os << "    int method" << m << "(int value) const {\n";
+            writeBody(os, "        ", opts.stmts);
+            os << "    }\n";
+        }
+    }
+
+    void writeFriends(std::ostream& os, const std::string& name, unsigned friends)
+    {
+        for (unsigned f = 0; f < friends; ++f) {
+            if (f % 2)
+                os << "    friend class " << name << "Friend" << f << ";\n";
+            else
+                os << "    friend int " << name << "Inspect" << f << "(const " << name << "&);\n";
+        }
+    }
+
+    void writeClass(std::ostream& os, const std::string& name, Shape shape)
+    {
+        bool singleton = shape != Shape::Plain;
+        os << "class " << name << " {\n";
+        if (singleton) {
+            os << "private:\n";
+            if (shape == Shape::Naive || shape == Shape::IfNaive || shape == Shape::Flags)
+                os << "    static " << name << "* instance;\n";
+            if (shape == Shape::Flags)
+                os << "    static bool isCreated;\n";
+            os << "    " << name << "() {}\n";
+            os << "    " << name << "(const " << name << "&) = delete;\n";
+            os << "    " << name << "& operator=(const " << name << "&) = delete;\n";
+            if (shape == Shape::FriendGetInstance)
+                os << "    friend " << name << "& get" << name << "();\n";
+        }
+        os << "public:\n";
+        switch (shape) {
+            case Shape::Naive:
+                os << "    static const " << name << "& getInstance() {\n"
+                   << "        return (instance != nullptr) ? *instance : *(instance = new " << name << "());\n"
+                   << "    }\n";
+                break;
+            case Shape::IfNaive:
+                os << "    static const " << name << "* getInstance() {\n"
+                   << "        if (!instance)\n"
+                   << "            instance = new " << name << "();\n"
+                   << "        return instance;\n"
+                   << "    }\n";
+                break;
+            case Shape::Flags:
+                os << "    static const " << name << "* getInstance() {\n"
+                   << "        return (isCreated) ? instance : (instance = new " << name << "());\n"
+                   << "    }\n";
+                break;
+            case Shape::Meyers:
+                os << "    static " << name << "& getInstance() {\n"
+                   << "        static " << name << " instance;\n"
+                   << "        return instance;\n"
+                   << "    }\n";
+                break;
+            default:
+                break;
+        }
+        writeMethods(os, opts.methods);
+        writeFriends(os, name, opts.friends);
+        os << "};\n";
+
+        if (shape == Shape::Naive || shape == Shape::IfNaive || shape == Shape::Flags)
+            os << name << "* " << name << "::instance = nullptr;\n";
+        if (shape == Shape::Flags)
+            os << "bool " << name << "::isCreated = false;\n";
+        if (shape == Shape::FriendGetInstance)
+            os << name << "& get" << name << "() {\n"
+               << "    static " << name << " inst;\n"
+               << "    return inst;\n"
+               << "}\n";
+        os << "\n";
+    }
+
+    void writeCRTP(std::ostream& os, const std::string& prefix, unsigned count)
+    {
+        if (!count) return;
+        os << "template<typename T>\n"
+              "class " << prefix << "CRTPSingleton {\n"
+              "protected:\n"
+              "    " << prefix << "CRTPSingleton() {}\n"
+              "    " << prefix << "CRTPSingleton(const " << prefix << "CRTPSingleton&) = delete;\n"
+              "    " << prefix << "CRTPSingleton& operator=(const " << prefix << "CRTPSingleton&) = delete;\n"
+              "public:\n"
+              "    static T& getInstance() {\n"
+              "        static T instance;\n"
+              "        return instance;\n"
+              "    }\n"
+              "};\n\n";
+        for (unsigned i = 0; i < count; ++i) {
+            std::string name = prefix + "Derived" + std::to_string(i);
+            os << "class " << name << " : public " << prefix << "CRTPSingleton<" << name << "> {\n"
+               << "    friend class " << prefix << "CRTPSingleton<" << name << ">;\n"
+               << "private:\n"
+               << "    " << name << "() {}\n"
+               << "};\n";
+        }
+        os << "\n";
+    }
+
+public:
+    explicit CorpusGenerator(const CorpusOptions& opts) : opts(opts), rng(opts.seed) {}
+
+    std::string generateTU(unsigned tu)
+    {
+        std::ostringstream os;
+        std::string prefix = "TU" + std::to_string(tu) + "_";
+        os << "// Generated by corpus-generator, do not edit.\n\n";
+        for (unsigned c = 0; c < opts.classes; ++c) {
+            Shape shape = static_cast<Shape>(c % static_cast<unsigned>(Shape::NumShapes));
+            writeClass(os, prefix + "Class" + std::to_string(c), shape);
+        }
+        writeCRTP(os, prefix, opts.crtp);
+        return os.str();
+    }
+};
+
+bool parseUnsigned(const char* value, unsigned& out)
+{
+    char* end = nullptr;
+    unsigned long parsed = std::strtoul(value, &end, 10);
+    if (!*value || *end) return false;
+    out = static_cast<unsigned>(parsed);
+    return true;
+}
+
+bool parseArgs(int argc, char** argv, CorpusOptions& opts)
+{
+    struct { const char* name; unsigned* value; } counts[] = {
+        {"-tus=", &opts.tus}, {"-classes=", &opts.classes}, {"-methods=", &opts.methods},
+        {"-friends=", &opts.friends}, {"-stmts=", &opts.stmts}, {"-crtp=", &opts.crtp},
+        {"-seed=", &opts.seed},
+    };
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (!std::strncmp(arg, "-out=", 5)) {
+            opts.out = arg + 5;
+            continue;
+        }
+        bool known = false;
+        for (auto& count : counts) {
+            size_t len = std::strlen(count.name);
+            if (std::strncmp(arg, count.name, len)) continue;
+            if (!parseUnsigned(arg + len, *count.value)) {
+                std::cerr << "corpus-generator: invalid value in '" << arg << "'\n";
+                return false;
+            }
+            known = true;
+        }
+        if (!known) {
+            std::cerr << "corpus-generator: unknown argument '" << arg << "'\n"
+                      << "usage: corpus-generator [-out=<dir>] [-tus=<n>] [-classes=<n>] [-methods=<n>]\n"
+                      << "                        [-friends=<n>] [-stmts=<n>] [-crtp=<n>] [-seed=<n>]\n";
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    CorpusOptions opts;
+    if (!parseArgs(argc, argv, opts))
+        return 1;
+
+    std::error_code ec;
+    std::filesystem::create_directories(opts.out, ec);
+    if (ec) {
+        std::cerr << "corpus-generator: cannot create " << opts.out << ": " << ec.message() << "\n";
+        return 1;
+    }
+
+    CorpusGenerator generator(opts);
+    for (unsigned tu = 0; tu < opts.tus; ++tu) {
+        std::ofstream file(opts.out + "/tu" + std::to_string(tu) + ".cpp");
+        file << generator.generateTU(tu);
+        if (!file) {
+            std::cerr << "corpus-generator: cannot write TU " << tu << "\n";
+            return 1;
+        }
+    }
+
+    std::ofstream manifest(opts.out + "/corpus.json");
+    manifest << "{\"tus\":" << opts.tus << ",\"classes\":" << opts.classes
+             << ",\"methods\":" << opts.methods << ",\"friends\":" << opts.friends
+             << ",\"stmts\":" << opts.stmts << ",\"crtp\":" << opts.crtp
+             << ",\"seed\":" << opts.seed << "}\n";
+    return manifest ? 0 : 1;
+}
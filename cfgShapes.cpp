@@ -0,0 +1,72 @@
+#include <mutex>
+
+// getInstance shapes -engine=cfg must report as If-Naive (see test-engines):
+// none of them assigns the instance in a top level if of getInstance.
+
+// the check nested under a lock, inside a block
+class ScopedLockSingleton {
+private:
+    static ScopedLockSingleton* instance;
+    static std::mutex mutex;
+
+    ScopedLockSingleton() {}
+    ScopedLockSingleton(const ScopedLockSingleton&) = delete;
+    ScopedLockSingleton& operator=(const ScopedLockSingleton&) = delete;
+
+public:
+    static ScopedLockSingleton* getInstance() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!instance)
+                instance = new ScopedLockSingleton();
+        }
+        return instance;
+    }
+};
+
+// early return once the instance exists
+class EarlyReturnSingleton {
+private:
+    static EarlyReturnSingleton* instance;
+
+    EarlyReturnSingleton() {}
+    EarlyReturnSingleton(const EarlyReturnSingleton&) = delete;
+    EarlyReturnSingleton& operator=(const EarlyReturnSingleton&) = delete;
+
+public:
+    static EarlyReturnSingleton* getInstance() {
+        if (instance)
+            return instance;
+        instance = new EarlyReturnSingleton();
+        return instance;
+    }
+};
+
+// creation split into create(), the check nested in another if
+class DeferredSingleton {
+private:
+    static DeferredSingleton* instance;
+    static bool enabled;
+
+    DeferredSingleton() {}
+    DeferredSingleton(const DeferredSingleton&) = delete;
+    DeferredSingleton& operator=(const DeferredSingleton&) = delete;
+
+public:
+    static void create() {
+        if (enabled) {
+            if (instance == nullptr)
+                instance = new DeferredSingleton();
+        }
+    }
+
+    static DeferredSingleton* getInstance() {
+        return instance;
+    }
+};
+
+ScopedLockSingleton* ScopedLockSingleton::instance = nullptr;
+std::mutex ScopedLockSingleton::mutex;
+EarlyReturnSingleton* EarlyReturnSingleton::instance = nullptr;
+DeferredSingleton* DeferredSingleton::instance = nullptr;
+bool DeferredSingleton::enabled = true;
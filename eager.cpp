@@ -0,0 +1,22 @@
+#include <map>
+#include <string>
+
+class Config {
+private:
+    static Config instance;
+    std::map<std::string, std::string> values;
+
+    Config() {
+        values["mode"] = "default";
+    }
+    Config(const Config&) = delete;
+    Config& operator=(const Config&) = delete;
+
+public:
+    static Config& get() {
+        return instance;
+    }
+};
+
+// dynamic initialization before main: Config::Config() is user provided
+Config Config::instance;
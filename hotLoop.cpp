@@ -0,0 +1,30 @@
+#include <vector>
+
+class Logger {
+private:
+    Logger() {}
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
+public:
+    static Logger& getInstance() {
+        static Logger instance;
+        return instance;
+    }
+
+    void write(int value) {}
+    const std::vector<int>& levels() const { static std::vector<int> l; return l; }
+};
+
+void process(const std::vector<int>& values) {
+    // reported: depth 1 and depth 2
+    for (int value : values) {
+        Logger::getInstance().write(value);
+        for (int i = 0; i < value; ++i)
+            Logger::getInstance().write(i);
+    }
+
+    // not reported: the range and the init run once
+    for (int level : Logger::getInstance().levels()) {}
+    for (Logger* logger = &Logger::getInstance(); logger; logger = nullptr) {}
+}